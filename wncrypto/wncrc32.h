@@ -69,10 +69,12 @@ static const unsigned int crc32tab[] = {
     0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL, 0x2d02ef8dL
 };
 
-unsigned int crc32(const unsigned char* buf, unsigned int size)
+// 分段计算：crc32Update(crc32Update(0, a, na), b, nb) == crc32(a+b)
+// inline: 头文件中的定义被多个编译单元包含时不违反 ODR
+inline unsigned int crc32Update(unsigned int crc, const unsigned char* buf, unsigned int size)
 {
-    unsigned int i, crc;
-    crc = 0xFFFFFFFF;
+    unsigned int i;
+    crc = crc ^ 0xFFFFFFFF;
 
     for (i = 0; i < size; i++)
         crc = crc32tab[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
@@ -80,4 +82,9 @@ unsigned int crc32(const unsigned char* buf, unsigned int size)
     return crc ^ 0xFFFFFFFF;
 }
 
+inline unsigned int crc32(const unsigned char* buf, unsigned int size)
+{
+    return crc32Update(0, buf, size);
+}
+
 #endif
\ No newline at end of file
@@ -37,6 +37,7 @@ documentation and/or software.
 
 /* system implementation headers */
 #include <cstdio>  
+#include <cstring>
 
 
 // Constants for MD5Transform routine.  
@@ -339,12 +340,14 @@ std::string MD5::hexdigest() const
 	if (!finalized)
 		return "";
 
-	char buf[33];
-	for (int i = 0; i < 16; i++)
-		sprintf(buf + i * 2, "%02x", digest[i]);
-	buf[32] = 0;
+	static const char digits[] = "0123456789abcdef";
+	char buf[32];
+	for (int i = 0; i < 16; i++) {
+		buf[i * 2] = digits[digest[i] >> 4];
+		buf[i * 2 + 1] = digits[digest[i] & 0xF];
+	}
 
-	return std::string(buf);
+	return std::string(buf, sizeof buf);
 }
 
 //////////////////////////////  
@@ -0,0 +1,288 @@
+// wnlogbench: 日志吞吐和单次调用延迟的基准测试。
+// 覆盖 1..N 个线程、不同的消息形态和不同的输出端，结果每行一个 JSON 对象，便于脚本比较。
+//
+// 编译(在本目录下):
+//   g++ -O2 -std=c++17 -o wnlogbench wnlogbench.cc ../wnlogging.cc ../wnlogstream.cc
+//       ../wncurrentthread.cc ../wnmmaplogfile.cc ../wncompresslog.cc ../wnlz.cc
+//       ../../wnthreadpool/wnthreadpool.cc -pthread
+// 用法:
+//   wnlogbench [-t 最大线程数] [-n 每线程消息数] [-s null,stdout,file,mmap,async]
+//              [-m text,int,double,string] [-d 临时文件目录] [-o 结果文件] > /dev/null
+// stdout 输出端会向标准输出写日志，结果默认写到标准错误。
+// seconds 从第一个线程开始写到输出端排空为止：async 的压缩和写盘、file/stdout 的 fflush 都计入，
+// 其中排空部分另见 drain_seconds。延迟分位数只统计调用方线程内的单次 LOG_* 耗时。
+
+#include "../wncompresslog.h"
+#include "../wnlogging.h"
+#include "../wnmmaplogfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+FILE* g_file = nullptr;
+MmapLogFile* g_mmapFile = nullptr;
+CompressedLogSink* g_asyncSink = nullptr;
+
+void nullOutput(const char*, int) {}
+void nullFlush() {}
+void stdoutOutput(const char* msg, int len) { fwrite(msg, 1, len, stdout); }
+void stdoutFlush() { fflush(stdout); }
+void fileOutput(const char* msg, int len) { fwrite(msg, 1, len, g_file); }
+void fileFlush() { fflush(g_file); }
+void mmapOutput(const char* msg, int len) { g_mmapFile->append(msg, len); }
+void mmapFlush() { g_mmapFile->flush(); }
+void asyncOutput(const char* msg, int len) { g_asyncSink->append(msg, len); }
+void asyncFlush() { g_asyncSink->flush(); }
+
+struct Options {
+    int maxThreads = 4;
+    int messages = 200000;
+    std::vector<std::string> sinks { "null", "stdout", "file", "mmap", "async" };
+    std::vector<std::string> shapes { "text", "int", "double", "string" };
+    std::string dir = ".";
+    FILE* out = stderr;
+};
+
+std::vector<std::string> split(const char* arg)
+{
+    std::vector<std::string> items;
+    std::string s(arg);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == std::string::npos) {
+            comma = s.size();
+        }
+        if (comma > start) {
+            items.push_back(s.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return items;
+}
+
+// 设置输出端，返回 false 表示名字不认识
+bool setupSink(const std::string& sink, const Options& opt)
+{
+    std::string path = opt.dir + "/wnlogbench." + sink + ".log";
+    if (sink == "null") {
+        Logger::setOutput(nullOutput);
+        Logger::setFlush(nullFlush);
+    } else if (sink == "stdout") {
+        Logger::setOutput(stdoutOutput);
+        Logger::setFlush(stdoutFlush);
+    } else if (sink == "file") {
+        g_file = fopen(path.c_str(), "w");
+        if (!g_file) {
+            return false;
+        }
+        Logger::setOutput(fileOutput);
+        Logger::setFlush(fileFlush);
+    } else if (sink == "mmap") {
+        g_mmapFile = new MmapLogFile(path);
+        Logger::setOutput(mmapOutput);
+        Logger::setFlush(mmapFlush);
+    } else if (sink == "async") {
+        g_asyncSink = new CompressedLogSink(path + ".wnz");
+        Logger::setOutput(asyncOutput);
+        Logger::setFlush(asyncFlush);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void teardownSink(const std::string& sink, const Options& opt)
+{
+    std::string path = opt.dir + "/wnlogbench." + sink + ".log";
+    if (g_file) {
+        fclose(g_file);
+        g_file = nullptr;
+    }
+    delete g_mmapFile;
+    g_mmapFile = nullptr;
+    delete g_asyncSink; // 等待后台写完
+    g_asyncSink = nullptr;
+    unlink(path.c_str());
+    unlink((path + ".wnz").c_str());
+}
+
+// 把输出端缓冲的数据全部写出。async 要等后台线程把已提交的块压缩、写完
+void drainSink()
+{
+    if (g_file) {
+        fflush(g_file);
+    }
+    if (g_mmapFile) {
+        g_mmapFile->flush();
+    }
+    if (g_asyncSink) {
+        g_asyncSink->flush();
+        g_asyncSink->waitIdle();
+    }
+    fflush(stdout);
+}
+
+// 各种消息形态，每次调用写一条日志
+void logOnce(int shape, int i, const std::string& longStr)
+{
+    switch (shape) {
+    case 0:
+        LOG_INFO << "connection accepted, waiting for request headers";
+        break;
+    case 1:
+        LOG_INFO << "id=" << i << " user=" << i * 7 << " bytes=" << i * 131L
+                 << " status=" << 200 << " retries=" << (i & 3);
+        break;
+    case 2:
+        LOG_INFO << "lat=" << i * 0.001 << " p99=" << i * 1.37 << " ratio=" << 1.0 / (i + 1);
+        break;
+    default:
+        LOG_INFO << "payload=" << longStr;
+        break;
+    }
+}
+
+struct Result {
+    double seconds; // 包含排空
+    double drainSeconds; // 生产线程全部结束之后排空输出端的时间
+    std::vector<int64_t> latencies; // 纳秒
+};
+
+void runThread(int shape, int messages, const std::string& longStr, std::vector<int64_t>* latencies)
+{
+    latencies->resize(messages);
+    for (int i = 0; i < messages; ++i) {
+        Clock::time_point start = Clock::now();
+        logOnce(shape, i, longStr);
+        (*latencies)[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+}
+
+Result runCase(int shape, int threads, int messages, const std::string& longStr)
+{
+    std::vector<std::vector<int64_t>> perThread(threads);
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back(runThread, shape, messages, std::cref(longStr), &perThread[t]);
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    Clock::time_point produced = Clock::now();
+    drainSink();
+    Result result;
+    Clock::time_point drained = Clock::now();
+    result.seconds = std::chrono::duration<double>(drained - start).count();
+    result.drainSeconds = std::chrono::duration<double>(drained - produced).count();
+    for (auto& v : perThread) {
+        result.latencies.insert(result.latencies.end(), v.begin(), v.end());
+    }
+    return result;
+}
+
+int64_t percentile(std::vector<int64_t>& sorted, double p)
+{
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+std::vector<int> threadCounts(int maxThreads)
+{
+    std::vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    const char* outPath = nullptr;
+    int c;
+    while ((c = getopt(argc, argv, "t:n:s:m:d:o:")) != -1) {
+        switch (c) {
+        case 't':
+            opt.maxThreads = std::max(1, atoi(optarg));
+            break;
+        case 'n':
+            opt.messages = std::max(1, atoi(optarg));
+            break;
+        case 's':
+            opt.sinks = split(optarg);
+            break;
+        case 'm':
+            opt.shapes = split(optarg);
+            break;
+        case 'd':
+            opt.dir = optarg;
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-n messages] [-s sinks] [-m shapes] [-d dir] [-o out]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (outPath && !(opt.out = fopen(outPath, "w"))) {
+        perror(outPath);
+        return 1;
+    }
+
+    static const char* const kShapeNames[] = { "text", "int", "double", "string" };
+    const std::string longStr(1024, 's');
+
+    for (const std::string& sink : opt.sinks) {
+        for (const std::string& shapeName : opt.shapes) {
+            int shape = std::find(std::begin(kShapeNames), std::end(kShapeNames), shapeName) - std::begin(kShapeNames);
+            if (shape == 4) {
+                fprintf(stderr, "unknown shape: %s\n", shapeName.c_str());
+                return 2;
+            }
+            for (int threads : threadCounts(opt.maxThreads)) {
+                if (!setupSink(sink, opt)) {
+                    fprintf(stderr, "cannot set up sink: %s\n", sink.c_str());
+                    return 2;
+                }
+                Result r = runCase(shape, threads, opt.messages, longStr);
+                teardownSink(sink, opt);
+
+                std::sort(r.latencies.begin(), r.latencies.end());
+                long total = static_cast<long>(threads) * opt.messages;
+                fprintf(opt.out,
+                    "{\"sink\":\"%s\",\"shape\":\"%s\",\"threads\":%d,\"messages\":%ld,"
+                    "\"seconds\":%.6f,\"drain_seconds\":%.6f,\"msgs_per_sec\":%.0f,"
+                    "\"p50_ns\":%ld,\"p90_ns\":%ld,\"p99_ns\":%ld,\"p999_ns\":%ld,\"max_ns\":%ld}\n",
+                    sink.c_str(), shapeName.c_str(), threads, total, r.seconds, r.drainSeconds, total / r.seconds,
+                    static_cast<long>(percentile(r.latencies, 0.5)),
+                    static_cast<long>(percentile(r.latencies, 0.9)),
+                    static_cast<long>(percentile(r.latencies, 0.99)),
+                    static_cast<long>(percentile(r.latencies, 0.999)),
+                    static_cast<long>(r.latencies.back()));
+                fflush(opt.out);
+            }
+        }
+    }
+    if (opt.out != stderr) {
+        fclose(opt.out);
+    }
+    return 0;
+}
@@ -1,6 +1,392 @@
 #include <iostream>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "wnlogging.h"
+#include "wncompresslog.h"
+#include "wncurrentthread.h"
+#include "wnlogrecord.h"
+#include "wnlz.h"
+#include "wnmmaplogfile.h"
 
+// ASan/TSan 自己接管 malloc，再转发给 __libc_* 会混用两套堆，此时不编译分配计数，只跳过这一项检查
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define WN_SANITIZER 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define WN_SANITIZER 1
+#endif
+#endif
+
+std::atomic<bool> g_countAllocs(false);
+std::atomic<long> g_allocs(0);
+
+#ifndef WN_SANITIZER
+// 分配计数：替换 malloc/calloc/realloc(operator new 也经由 malloc)，
+// 在 g_countAllocs 打开期间统计分配次数
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+
+extern "C" void* malloc(size_t n)
+{
+	if (g_countAllocs.load(std::memory_order_relaxed))
+		g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(n);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+	if (g_countAllocs.load(std::memory_order_relaxed))
+		g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t n)
+{
+	if (g_countAllocs.load(std::memory_order_relaxed))
+		g_allocs.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(p, n);
+}
+#endif
+
+void nullOutput(const char*, int) {}
+void nullOutputV(const struct iovec*, int) {}
+
+void logAllShapes(const std::string& str, const std::string& big)
+{
+	errno = 2;
+	LOG_SYSERR << "open failed";
+	LOG_INFO << "text only";
+	LOG_INFO << 1 << ' ' << -2L << ' ' << 3ULL << ' ' << 4.5 << ' ' << &str;
+	LOG_WARN << str << std::string_view("view");
+	LOG_ERROR.kv("user", 42).kv("path", str).kv("lat", 1.5).kv("ok", true);
+	LOG_DEBUG << "debug";
+	LOG_EVERY_N(INFO, 3) << "every 3";
+	LOG_SAMPLED(INFO, 0.5) << "sampled";
+	LOG_INFO << big << 123;
+	LOG_INFO << Hex(big.data(), 64) << HexDump(str.data(), str.size());
+}
+
+// 稳态下 LOG_* 路径不应有任何堆分配；返回 false 表示检测到分配
+bool checkNoAllocation()
+{
+	std::string str("a b=\"c\"");
+	std::string big(20000, 'y');
+	Logger::setOutput(nullOutput);
+	Logger::setOutputV(nullOutputV);
+
+	// 预热：时区、线程 tid、溢出块池等线程局部状态的首次初始化
+	logAllShapes(str, big);
+
+	g_allocs = 0;
+	g_countAllocs = true;
+	for (int i = 0; i < 1000; ++i) {
+		logAllShapes(str, big);
+	}
+	g_countAllocs = false;
+
+#ifdef WN_SANITIZER
+	std::cout << "allocations in steady-state logging: not counted under sanitizer" << std::endl;
+	return true;
+#else
+	std::cout << "allocations in steady-state logging: " << g_allocs.load() << std::endl;
+	return g_allocs.load() == 0;
+#endif
+}
+
+
+// logfmt 的键与值同样需要转义，否则解析器无法切分
+bool checkKvKeys()
+{
+	LogStream s;
+	s.kv("user", 1).kv("bad key", 2).kv("a=b", "x").kv("q\"", "y");
+	std::string out = s.buffer().toString();
+	if (out != " user=1 \"bad key\"=2 \"a=b\"=x \"q\\\"\"=y") {
+		std::cout << "FAIL: logfmt keys not escaped: " << out << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// 记录文件末尾的全零填充不能被读成空记录，恢复扫描也不能把它算进有效数据
+bool checkZeroTail()
+{
+	std::string path = "/tmp/wnlogrecord_test." + std::to_string(getpid()) + ".wlog";
+	unlink(path.c_str());
+	{
+		BinaryLogWriter writer(path);
+		for (int i = 0; i < 20000; ++i) {
+			std::string line = "record " + std::to_string(i);
+			writer.append(line.data(), line.size());
+		}
+		writer.append("", 0);
+	}
+	off_t committed;
+	{
+		FILE* fp = fopen(path.c_str(), "ab");
+		committed = ftello(fp);
+		char zeros[4096] = {};
+		fwrite(zeros, 1, sizeof zeros, fp);
+		fclose(fp);
+	}
+	BinaryLogReader reader(path);
+	BinaryLogReader::Record rec;
+	int count = 0;
+	while (reader.next(&rec)) {
+		++count;
+	}
+	reader.rewind();
+	uint64_t end = reader.validEnd();
+	unlink(path.c_str());
+	if (count != 20000 || end != static_cast<uint64_t>(committed)) {
+		std::cout << "FAIL: zero tail read as " << count - 20000 << " records, validEnd " << end
+			<< " of " << committed << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::string readFile(const std::string& path)
+{
+	std::string content;
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp) {
+		char buf[65536];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+			content.append(buf, n);
+		}
+		fclose(fp);
+	}
+	return content;
+}
+
+// 子进程写完不关闭直接退出(模拟崩溃)，文件末尾留着预分配的 NUL 填充；
+// 重新打开后要接在已写内容之后。再在子进程里限制地址空间让下一个窗口 mmap 失败，数据要经 pwrite 写完
+bool checkMmapLogFile()
+{
+	std::string path = "/tmp/wnmmaplogfile_test." + std::to_string(getpid()) + ".log";
+	unlink(path.c_str());
+	std::string expected;
+	for (int i = 0; i < 3000; ++i) {
+		expected += "line " + std::to_string(i) + "\n";
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		MmapLogFile* file = new MmapLogFile(path, 64 * 1024);
+		file->append(expected.data(), expected.size());
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || st.st_size <= static_cast<off_t>(expected.size())) {
+		std::cout << "FAIL: crashed mmap log file has no padding" << std::endl;
+		return false;
+	}
+	{
+		MmapLogFile file(path, 64 * 1024);
+		file.append("after crash\n", 12);
+	}
+	expected += "after crash\n";
+	if (readFile(path) != expected) {
+		std::cout << "FAIL: mmap log file did not resume after the crash padding" << std::endl;
+		return false;
+	}
+
+#ifdef WN_SANITIZER
+	// sanitizer 的影子内存也要新映射，限制地址空间会让它自己先失败
+	unlink(path.c_str());
+	return true;
+#else
+	const size_t window = 8 * 1024 * 1024;
+	std::string chunk(window / 2, 'm');
+	pid = fork();
+	if (pid == 0) {
+		MmapLogFile file(path, window);
+		long pages = 0;
+		FILE* fp = fopen("/proc/self/statm", "r");
+		if (!fp || fscanf(fp, "%ld", &pages) != 1) {
+			_exit(2);
+		}
+		fclose(fp);
+		struct rlimit limit;
+		// 换出的窗口先 munmap 再映射下一个，上限要比当前用量少半个窗口才能让新窗口映射失败
+		limit.rlim_cur = limit.rlim_max = pages * sysconf(_SC_PAGESIZE) - window / 2;
+		setrlimit(RLIMIT_AS, &limit);
+		for (int i = 0; i < 4; ++i) {
+			file.append(chunk.data(), chunk.size());
+		}
+		_exit(file.ok() ? 3 : 0);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	std::string content = readFile(path);
+	unlink(path.c_str());
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || content.size() != expected.size() + 4 * chunk.size()
+		|| content.compare(0, expected.size(), expected) != 0
+		|| content.find_first_not_of('m', expected.size()) != std::string::npos) {
+		std::cout << "FAIL: mmap log file dropped data after mmap failed, status " << status << std::endl;
+		return false;
+	}
+	return true;
+#endif
+}
+
+// 随机长度、随机重复度的输入压缩后必须原样解压；对压缩数据截断或改写后解压不能越界
+bool checkLzFuzz()
+{
+	std::mt19937 rng(12345);
+	const char* words[] = { "INFO ", "request ", "user=", "42 ", "latency_us=", "\n", "GET /index.html " };
+	for (int i = 0; i < 2000; ++i) {
+		size_t len = i < 300 ? i : rng() % (i % 10 == 0 ? 200000 : 5000);
+		std::string src;
+		src.reserve(len);
+		int shape = i % 4;
+		while (src.size() < len) {
+			if (shape == 0) {
+				src.push_back(static_cast<char>(rng()));
+			} else if (shape == 1) {
+				src.append(words[rng() % 7]);
+			} else if (shape == 2) {
+				src.append(rng() % 300, static_cast<char>('a' + rng() % 3));
+			} else {
+				src.append(rng() % 2 ? words[rng() % 7] : std::string(1, static_cast<char>(rng())));
+			}
+		}
+		src.resize(len);
+
+		std::vector<char> packed(lzCompressBound(len));
+		size_t n = lzCompress(src.data(), len, packed.data());
+		std::vector<char> out(len + 1);
+		if (n > packed.size() || !lzDecompress(packed.data(), n, out.data(), len)
+			|| memcmp(out.data(), src.data(), len) != 0) {
+			std::cout << "FAIL: lz round trip, case " << i << " len " << len << std::endl;
+			return false;
+		}
+		// 损坏的输入只要求不崩溃、不越界；返回值不论
+		if (n > 0) {
+			std::vector<char> bad(packed.begin(), packed.begin() + n);
+			bad[rng() % n] ^= static_cast<char>(1 + rng() % 255);
+			lzDecompress(bad.data(), n, out.data(), len);
+			lzDecompress(packed.data(), rng() % n, out.data(), len);
+		}
+	}
+	return true;
+}
+
+std::string decompressToString(const std::string& path, long* corrupted)
+{
+	FILE* out = tmpfile();
+	*corrupted = decompressLogFile(path, out);
+	std::string content;
+	rewind(out);
+	char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof buf, out)) > 0) {
+		content.append(buf, n);
+	}
+	fclose(out);
+	return content;
+}
+
+CompressedLogSink* g_testSink = nullptr;
+void testSinkFlush() { g_testSink->flush(); }
+
+// CompressedLogSink 写出的文件经 decompressLogFile(即 wnlogcat)解出来要与写入的内容一致。
+// 作为 Logger 的 flush 回调调用后，不析构 sink 也能读到全部内容(FATAL 在 abort 前只调用 flush)；
+// 末尾崩溃留下的半个块只计一个损坏块，不影响前面的内容
+bool checkCompressedSink()
+{
+	std::string path = "/tmp/wncompresslog_test." + std::to_string(getpid()) + ".wnz";
+	unlink(path.c_str());
+	std::string expected;
+	long corrupted = 0;
+	{
+		CompressedLogSink sink(path, 4096);
+		g_testSink = &sink;
+		for (int i = 0; i < 10000; ++i) {
+			std::string line = "[12:00:00] INFO  [threadID:1] msg: line " + std::to_string(i) + " --test.cc:1\n";
+			sink.append(line.data(), line.size());
+			expected += line;
+			if (i % 3000 == 0) {
+				sink.flush();
+			}
+		}
+		Logger::FlushFunc hook = testSinkFlush;
+		hook();
+		if (decompressToString(path, &corrupted) != expected || corrupted != 0) {
+			std::cout << "FAIL: compressed log incomplete after flush" << std::endl;
+			return false;
+		}
+		g_testSink = nullptr;
+	}
+	{
+		// 块头按小端编码，与主机字节序无关
+		CompressedBlockHeader header = { CompressedBlockHeader::kMagic, 0x04030201, 0x80000005, 0 };
+		char encoded[CompressedBlockHeader::kSize];
+		header.encode(encoded);
+		CompressedBlockHeader back;
+		back.decode(encoded);
+		if (memcmp(encoded, "WNZ1\x01\x02\x03\x04\x05\x00\x00\x80", 12) != 0 || back.rawLen_ != header.rawLen_
+			|| back.storedLen_ != header.storedLen_) {
+			std::cout << "FAIL: compressed block header is not little-endian" << std::endl;
+			return false;
+		}
+	}
+	{
+		FILE* fp = fopen(path.c_str(), "ab");
+		CompressedBlockHeader header = { CompressedBlockHeader::kMagic, 100, 100, 0 };
+		char encoded[CompressedBlockHeader::kSize];
+		header.encode(encoded);
+		fwrite(encoded, 1, sizeof encoded, fp);
+		fwrite("half", 1, 4, fp);
+		fclose(fp);
+	}
+	std::string content = decompressToString(path, &corrupted);
+	unlink(path.c_str());
+	if (corrupted != 1 || content != expected) {
+		std::cout << "FAIL: compressed log round trip, corrupted " << corrupted << ", " << content.size()
+			<< " of " << expected.size() << " bytes" << std::endl;
+		return false;
+	}
+
+	// 小块让队列一直处于满的状态：多个线程 append、另一个线程 flush，不能死锁也不能丢数据
+	{
+		CompressedLogSink sink(path, 256);
+		std::vector<std::thread> writers;
+		for (int t = 0; t < 4; ++t) {
+			writers.emplace_back([&sink]() {
+				for (int i = 0; i < 5000; ++i) {
+					sink.append("0123456789abcdef\n", 17);
+				}
+			});
+		}
+		std::thread flusher([&sink]() {
+			for (int i = 0; i < 200; ++i) {
+				sink.flush();
+			}
+		});
+		for (std::thread& w : writers) {
+			w.join();
+		}
+		flusher.join();
+	}
+	content = decompressToString(path, &corrupted);
+	unlink(path.c_str());
+	if (corrupted != 0 || content.size() != 4 * 5000 * 17) {
+		std::cout << "FAIL: compressed log lost data under back-pressure" << std::endl;
+		return false;
+	}
+	return true;
+}
 
 int main()
 {
@@ -8,5 +394,38 @@ int main()
 	LOG_SYSERR ;
 	LOG_DEBUG << "test";
 
+	for (int i = 0; i < 25; ++i) {
+		LOG_EVERY_N(WARN, 10) << "every 10, i=" << i;
+		LOG_FIRST_N(INFO, 2) << "first 2, i=" << i;
+		LOG_EVERY_T(ERROR, 60) << "every 60s, i=" << i;
+		LOG_SAMPLED(DEBUG, 0.1) << "sampled, i=" << i;
+	}
+
+	LOG_INFO << "request done";
+	LOG_INFO.kv("user", 42).kv("latency_us", 12.5).kv("path", "/a b=\"c\"");
+	LogStream::setKvFormat(LogStream::kJson);
+	LOG_INFO.kv("user", 42).kv("ok", true).kv("path", "/a b\n\x01");
+	LogStream::setKvFormat(LogStream::kLogfmt);
+
+	std::thread worker([]() {
+		CurrentThread::setName("worker");
+		LOG_INFO << "from worker";
+	});
+	worker.join();
+
+	std::string payload(10000, 'x');
+	LOG_INFO << "big payload: " << payload << " tail=" << 12345;
+
+	const char frame[] = "\x01\x02GET /index.html HTTP/1.1\r\n";
+	LOG_INFO << "frame=" << Hex(frame, sizeof frame - 1) << HexDump(frame, sizeof frame - 1);
+	LOG_INFO << "big hex: " << Hex(payload.data(), 9000, true);
+
+	if (!checkKvKeys() || !checkZeroTail() || !checkMmapLogFile() || !checkLzFuzz() || !checkCompressedSink()) {
+		return 1;
+	}
+	if (!checkNoAllocation()) {
+		std::cout << "FAIL: logging allocated" << std::endl;
+		return 1;
+	}
 	return 0;
 }
\ No newline at end of file
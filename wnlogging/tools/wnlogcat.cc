@@ -0,0 +1,25 @@
+// wnlogcat: 把 CompressedLogSink / compressLogFile 产生的压缩日志解压到标准输出。
+// 遇到损坏的块(通常是崩溃时写了一半的最后一块)会报告并跳到下一个 magic 继续。
+//
+// 编译: g++ -O2 -std=c++17 -o wnlogcat wnlogcat.cc ../wncompresslog.cc ../wnlz.cc
+//       ../../wnthreadpool/wnthreadpool.cc -pthread
+// 用法: wnlogcat app.log.wnz [more.wnz ...]
+
+#include "../wncompresslog.h"
+
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file.wnz [more.wnz ...]\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (decompressLogFile(argv[i], stdout) != 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,620 @@
+// wnlogquery: 在本 Logger 写出的文本日志中按级别、源文件:行号、时间段和关键字检索。
+// 日志文件整体 mmap，按记录边界切成若干块交给 ThreadPool 并行扫描，结果按文件顺序输出。
+// 有源文件或关键字条件时先用 SIMD 子串搜索定位候选位置，只解析命中的记录。
+//
+// 记录格式见 Logger::Impl：
+//   [HH:MM:SS] LEVEL  [threadID:N] [fuc:f] msg: ... --file.cc:123\n
+// 消息本身可能跨行(如 HexDump)，只有以 "[HH:MM:SS] " 开头的行才算新记录。
+//
+// -I 生成旁路索引 <log>.idx：约每 64KB 一段，记录段起始偏移和段内最早/最晚时间。
+// 之后带时间条件的查询只扫描时间有交集的段，加上建索引之后追加的尾部。
+//
+// 编译(在本目录下):
+//   g++ -O2 -std=c++17 -o wnlogquery wnlogquery.cc ../../wnthreadpool/wnthreadpool.cc -pthread
+// 用法:
+//   wnlogquery [-l 最低级别] [-f file[:line]] [-b HH:MM:SS] [-a HH:MM:SS] [-e 关键字]
+//              [-j 线程数] [-c] app.log
+//   wnlogquery -I app.log
+
+#include "../../wnthreadpool/wnthreadpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const size_t kSegmentSize = 64 * 1024;   // 索引粒度
+const size_t kMinChunkSize = 1024 * 1024; // 单个扫描任务的最小字节数
+
+// ---------------------------------------------------------------------------
+// 子串搜索：先比较首尾两个字节筛出候选位置，再 memcmp 确认。
+// 对日志这种字母表较小的文本，首尾同时命中的位置很少。
+
+const char* findScalar(const char* s, size_t n, const char* needle, size_t m)
+{
+    return static_cast<const char*>(memmem(s, n, needle, m));
+}
+
+#if defined(__SSE2__)
+const char* findSse2(const char* s, size_t n, const char* needle, size_t m)
+{
+    if (m == 0 || n < m) {
+        return m == 0 ? s : nullptr;
+    }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(s + pos, needle, m) == 0) {
+                return s + pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(s + i, n - i, needle, m);
+}
+
+__attribute__((target("avx2")))
+const char* findAvx2(const char* s, size_t n, const char* needle, size_t m)
+{
+    if (m == 0 || n < m) {
+        return m == 0 ? s : nullptr;
+    }
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(s + pos, needle, m) == 0) {
+                return s + pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSse2(s + i, n - i, needle, m);
+}
+#endif
+
+typedef const char* (*FindFunc)(const char*, size_t, const char*, size_t);
+
+FindFunc resolveFind()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? findAvx2 : findSse2;
+#else
+    return findScalar;
+#endif
+}
+
+const char* findNeedle(const char* s, const char* end, const std::string& needle)
+{
+    static const FindFunc func = resolveFind();
+    return func(s, end - s, needle.data(), needle.size());
+}
+
+// ---------------------------------------------------------------------------
+// 记录解析
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// p 处是否为 "[HH:MM:SS] "
+bool isRecordStart(const char* p, const char* end)
+{
+    return end - p >= 11 && p[0] == '[' && isDigit(p[1]) && isDigit(p[2]) && p[3] == ':'
+        && isDigit(p[4]) && isDigit(p[5]) && p[6] == ':' && isDigit(p[7]) && isDigit(p[8])
+        && p[9] == ']' && p[10] == ' ';
+}
+
+int recordSeconds(const char* rec)
+{
+    return ((rec[1] - '0') * 10 + rec[2] - '0') * 3600 + ((rec[4] - '0') * 10 + rec[5] - '0') * 60
+        + (rec[7] - '0') * 10 + rec[8] - '0';
+}
+
+// LogLevelName 的首字母：DEBUG INFO WARN ERROR FATAL
+int levelRank(char c)
+{
+    switch (c) {
+    case 'D': return 0;
+    case 'I': return 1;
+    case 'W': return 2;
+    case 'E': return 3;
+    case 'F': return 4;
+    default: return -1;
+    }
+}
+
+// p 之后(不含 p 所在行的行首)的下一条记录起点，没有则为 end。
+// 换行符查找交给 glibc 的 memchr，它本身就是向量化的
+const char* nextRecord(const char* p, const char* end)
+{
+    for (;;) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!nl || nl + 1 >= end) {
+            return end;
+        }
+        if (isRecordStart(nl + 1, end)) {
+            return nl + 1;
+        }
+        p = nl + 1;
+    }
+}
+
+// 对齐到 p 处或之后的第一条记录
+const char* alignRecord(const char* p, const char* begin, const char* end)
+{
+    if (p == begin || (p[-1] == '\n' && isRecordStart(p, end))) {
+        return p;
+    }
+    return nextRecord(p, end);
+}
+
+// 包含 hit 的记录的起点，不早于 lo
+const char* recordStartBefore(const char* hit, const char* lo, const char* end)
+{
+    const char* p = hit + 1;
+    while (p > lo) {
+        const char* nl = static_cast<const char*>(memrchr(lo, '\n', p - 1 - lo));
+        const char* line = nl ? nl + 1 : lo;
+        if (!nl || isRecordStart(line, end)) {
+            return line;
+        }
+        p = nl + 1;
+    }
+    return lo;
+}
+
+// ---------------------------------------------------------------------------
+// 查询条件
+
+struct Query {
+    int minLevel = 0;
+    std::string file;     // 源文件名，空表示不限
+    std::string line;     // 行号，空表示该文件任意行
+    std::string pattern;  // 关键字
+    int from = -1;        // 时间下界(当天秒数)，-1 表示不限
+    int to = -1;          // 时间上界
+    bool countOnly = false;
+
+    // 定位候选记录用的锚点：源文件条件比关键字更有选择性
+    std::string anchor() const
+    {
+        if (!file.empty()) {
+            return " --" + file + ":" + (line.empty() ? "" : line + "\n");
+        }
+        return pattern;
+    }
+
+    bool hasTime() const { return from >= 0 || to >= 0; }
+
+    bool inTime(int t) const
+    {
+        if (from >= 0 && to >= 0 && from > to) {
+            return t >= from || t <= to; // 跨午夜
+        }
+        return (from < 0 || t >= from) && (to < 0 || t <= to);
+    }
+
+    // [mn, mx] 内是否可能有满足时间条件的记录
+    bool overlaps(int mn, int mx) const
+    {
+        if (from >= 0 && to >= 0 && from > to) {
+            return mx >= from || mn <= to;
+        }
+        return (from < 0 || mx >= from) && (to < 0 || mn <= to);
+    }
+};
+
+// 记录以 " --file:line" 结尾(之后可能有换行)
+bool matchSuffix(const Query& q, const char* rec, const char* recEnd)
+{
+    const char* e = recEnd;
+    if (e > rec && e[-1] == '\n') {
+        --e;
+    }
+    const char* digits = e;
+    while (digits > rec && isDigit(digits[-1])) {
+        --digits;
+    }
+    if (digits == e || digits == rec || digits[-1] != ':') {
+        return false;
+    }
+    if (!q.line.empty()
+        && (static_cast<size_t>(e - digits) != q.line.size() || memcmp(digits, q.line.data(), q.line.size()) != 0)) {
+        return false;
+    }
+    const char* colon = digits - 1;
+    size_t need = q.file.size() + 3;
+    return static_cast<size_t>(colon - rec) >= need && memcmp(colon - need, " --", 3) == 0
+        && memcmp(colon - q.file.size(), q.file.data(), q.file.size()) == 0;
+}
+
+bool matchRecord(const Query& q, const char* rec, const char* recEnd)
+{
+    if (!isRecordStart(rec, recEnd) || recEnd - rec < 16 || levelRank(rec[11]) < q.minLevel) {
+        return false;
+    }
+    if (q.hasTime() && !q.inTime(recordSeconds(rec))) {
+        return false;
+    }
+    if (!q.file.empty() && !matchSuffix(q, rec, recEnd)) {
+        return false;
+    }
+    if (!q.pattern.empty() && !findNeedle(rec, recEnd, q.pattern)) {
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// 分块并行
+
+struct Range {
+    size_t begin;
+    size_t end;
+};
+
+struct ChunkResult {
+    std::string out;
+    long matched = 0;
+};
+
+// 所有任务完成前阻塞调用者
+class Latch {
+public:
+    explicit Latch(int count): count_(count) {}
+
+    void countDown()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--count_ == 0) {
+            done_.notify_all();
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (count_ > 0) {
+            done_.wait(lock);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable done_;
+    int count_;
+};
+
+// 把各范围切成记录对齐的小块，块数大致为线程数的 4 倍以平衡负载
+std::vector<Range> splitRanges(const std::vector<Range>& ranges, const char* base, size_t size, int threads)
+{
+    size_t total = 0;
+    for (const Range& r : ranges) {
+        total += r.end - r.begin;
+    }
+    size_t chunk = std::max(kMinChunkSize, total / (threads * 4) + 1);
+
+    std::vector<Range> chunks;
+    const char* fileEnd = base + size;
+    for (const Range& r : ranges) {
+        size_t b = r.begin;
+        while (b < r.end) {
+            size_t e = std::min(r.end, b + chunk);
+            if (e < r.end) {
+                e = alignRecord(base + e, base, fileEnd) - base;
+                e = std::min(e, r.end);
+            }
+            chunks.push_back(Range { b, e });
+            b = e;
+        }
+    }
+    return chunks;
+}
+
+template <typename Func>
+void runChunks(const std::vector<Range>& chunks, int threads, Func func)
+{
+    ThreadPool pool("wnlogquery");
+    pool.start(threads);
+    Latch latch(static_cast<int>(chunks.size()));
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        pool.run([&, i]() {
+            func(i, chunks[i]);
+            latch.countDown();
+        });
+    }
+    latch.wait();
+}
+
+void scanChunk(const Query& q, const char* begin, const char* end, ChunkResult* result)
+{
+    std::string anchor = q.anchor();
+    const char* p = begin;
+    while (p < end) {
+        const char* rec = p;
+        if (!anchor.empty()) {
+            const char* hit = findNeedle(p, end, anchor);
+            if (!hit) {
+                break;
+            }
+            rec = recordStartBefore(hit, p, end);
+        }
+        const char* recEnd = nextRecord(rec, end);
+        if (matchRecord(q, rec, recEnd)) {
+            ++result->matched;
+            if (!q.countOnly) {
+                result->out.append(rec, recEnd - rec);
+            }
+        }
+        p = recEnd;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 旁路索引
+
+struct IndexHeader {
+    static const uint32_t kMagic = 0x58494E57; // "WNIX"
+    uint32_t magic_;
+    uint32_t segmentSize_;
+    uint64_t fileSize_; // 建索引时日志的长度，之后追加的部分不在索引内
+    uint64_t count_;
+};
+
+struct IndexEntry {
+    uint64_t offset_;
+    int32_t minSeconds_;
+    int32_t maxSeconds_;
+};
+
+std::string indexPath(const char* path) { return std::string(path) + ".idx"; }
+
+void indexChunk(const char* base, const char* begin, const char* end, std::vector<IndexEntry>* entries)
+{
+    const char* p = begin;
+    while (p < end) {
+        IndexEntry entry { static_cast<uint64_t>(p - base), 86400, -1 };
+        const char* segEnd = p;
+        while (segEnd < end && static_cast<size_t>(segEnd - p) < kSegmentSize) {
+            if (isRecordStart(segEnd, end)) {
+                int t = recordSeconds(segEnd);
+                entry.minSeconds_ = std::min(entry.minSeconds_, t);
+                entry.maxSeconds_ = std::max(entry.maxSeconds_, t);
+            }
+            segEnd = nextRecord(segEnd, end);
+        }
+        if (entry.maxSeconds_ < 0) {
+            // 段内没有可识别的记录头，保守地认为覆盖全天
+            entry.minSeconds_ = 0;
+            entry.maxSeconds_ = 86399;
+        }
+        entries->push_back(entry);
+        p = segEnd;
+    }
+}
+
+bool buildIndex(const char* path, const char* base, size_t size, int threads)
+{
+    std::vector<Range> chunks = splitRanges({ Range { 0, size } }, base, size, threads);
+    std::vector<std::vector<IndexEntry>> parts(chunks.size());
+    runChunks(chunks, threads, [&](size_t i, const Range& r) {
+        indexChunk(base, base + r.begin, base + r.end, &parts[i]);
+    });
+
+    std::string tmp = indexPath(path) + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        fprintf(stderr, "wnlogquery: %s: %s\n", tmp.c_str(), strerror(errno));
+        return false;
+    }
+    IndexHeader header { IndexHeader::kMagic, static_cast<uint32_t>(kSegmentSize), size, 0 };
+    for (const auto& part : parts) {
+        header.count_ += part.size();
+    }
+    bool ok = fwrite(&header, sizeof header, 1, fp) == 1;
+    for (const auto& part : parts) {
+        ok = ok && (part.empty() || fwrite(part.data(), sizeof(IndexEntry), part.size(), fp) == part.size());
+    }
+    ok = (fclose(fp) == 0) && ok;
+    // 先写临时文件再改名，查询方不会读到写了一半的索引
+    if (!ok || rename(tmp.c_str(), indexPath(path).c_str()) != 0) {
+        fprintf(stderr, "wnlogquery: failed to write %s\n", indexPath(path).c_str());
+        unlink(tmp.c_str());
+        return false;
+    }
+    fprintf(stderr, "wnlogquery: indexed %zu bytes in %llu segments\n", size,
+        static_cast<unsigned long long>(header.count_));
+    return true;
+}
+
+// 根据索引挑出需要扫描的范围；没有可用索引时返回整个文件
+std::vector<Range> selectRanges(const char* path, const Query& q, size_t size)
+{
+    std::vector<Range> all { Range { 0, size } };
+    if (!q.hasTime()) {
+        return all;
+    }
+    FILE* fp = fopen(indexPath(path).c_str(), "rb");
+    if (!fp) {
+        return all;
+    }
+    IndexHeader header;
+    std::vector<IndexEntry> entries;
+    bool ok = fread(&header, sizeof header, 1, fp) == 1 && header.magic_ == IndexHeader::kMagic
+        && header.fileSize_ <= size && header.count_ <= header.fileSize_ / sizeof(IndexEntry) + 1;
+    if (ok) {
+        entries.resize(header.count_);
+        ok = entries.empty() || fread(entries.data(), sizeof(IndexEntry), entries.size(), fp) == entries.size();
+    }
+    fclose(fp);
+    if (!ok) {
+        // 多半是日志被截断或轮转过，索引已过期
+        fprintf(stderr, "wnlogquery: ignoring stale index %s\n", indexPath(path).c_str());
+        return all;
+    }
+
+    std::vector<Range> ranges;
+    size_t skipped = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        size_t b = entries[i].offset_;
+        size_t e = i + 1 < entries.size() ? entries[i + 1].offset_ : header.fileSize_;
+        if (!q.overlaps(entries[i].minSeconds_, entries[i].maxSeconds_)) {
+            skipped += e - b;
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().end == b) {
+            ranges.back().end = e;
+        } else {
+            ranges.push_back(Range { b, e });
+        }
+    }
+    if (header.fileSize_ < size) {
+        ranges.push_back(Range { header.fileSize_, size });
+    }
+    fprintf(stderr, "wnlogquery: index skipped %zu of %zu bytes\n", skipped, size);
+    return ranges;
+}
+
+// "HH:MM:SS" -> 当天秒数，格式错误返回 -1
+int parseTime(const char* s)
+{
+    int h, m, sec;
+    if (sscanf(s, "%d:%d:%d", &h, &m, &sec) != 3 || h < 0 || h > 23 || m < 0 || m > 59 || sec < 0 || sec > 59) {
+        return -1;
+    }
+    return h * 3600 + m * 60 + sec;
+}
+
+int parseLevel(const char* s)
+{
+    return levelRank(static_cast<char>(toupper(static_cast<unsigned char>(s[0]))));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Query q;
+    bool index = false;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int c;
+    while ((c = getopt(argc, argv, "l:f:b:a:e:j:cI")) != -1) {
+        switch (c) {
+        case 'l':
+            q.minLevel = parseLevel(optarg);
+            break;
+        case 'f': {
+            q.file = optarg;
+            size_t colon = q.file.rfind(':');
+            if (colon != std::string::npos) {
+                q.line = q.file.substr(colon + 1);
+                q.file.resize(colon);
+            }
+            break;
+        }
+        case 'b':
+            q.from = parseTime(optarg);
+            break;
+        case 'a':
+            q.to = parseTime(optarg);
+            break;
+        case 'e':
+            q.pattern = optarg;
+            break;
+        case 'j':
+            threads = std::max(1, atoi(optarg));
+            break;
+        case 'c':
+            q.countOnly = true;
+            break;
+        case 'I':
+            index = true;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 1 || q.minLevel < 0) {
+        fprintf(stderr, "usage: %s [-l level] [-f file[:line]] [-b HH:MM:SS] [-a HH:MM:SS] [-e text] [-j threads] [-c] log\n"
+                        "       %s -I log\n",
+            argv[0], argv[0]);
+        return 2;
+    }
+    const char* path = argv[optind];
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "wnlogquery: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    const char* base = "";
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            fprintf(stderr, "wnlogquery: mmap %s: %s\n", path, strerror(errno));
+            close(fd);
+            return 1;
+        }
+        base = static_cast<const char*>(addr);
+    }
+    close(fd);
+
+    int ret = 0;
+    if (index) {
+        ret = buildIndex(path, base, size, threads) ? 0 : 1;
+    } else {
+        std::vector<Range> chunks = splitRanges(selectRanges(path, q, size), base, size, threads);
+        std::vector<ChunkResult> results(chunks.size());
+        runChunks(chunks, threads, [&](size_t i, const Range& r) {
+            scanChunk(q, base + r.begin, base + r.end, &results[i]);
+        });
+
+        long matched = 0;
+        for (const ChunkResult& r : results) {
+            matched += r.matched;
+            fwrite(r.out.data(), 1, r.out.size(), stdout);
+        }
+        if (q.countOnly) {
+            printf("%ld\n", matched);
+        }
+        ret = matched > 0 ? 0 : 1;
+    }
+
+    if (size > 0) {
+        munmap(const_cast<char*>(base), size);
+    }
+    return ret;
+}
@@ -0,0 +1,283 @@
+#include "wncompresslog.h"
+#include "wnlz.h"
+#include "../wncrypto/wncrc32.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+void putLe32(char* out, uint32_t v)
+{
+    out[0] = static_cast<char>(v);
+    out[1] = static_cast<char>(v >> 8);
+    out[2] = static_cast<char>(v >> 16);
+    out[3] = static_cast<char>(v >> 24);
+}
+
+uint32_t getLe32(const char* in)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// 在 [p, end) 中找下一个块头 magic
+const char* findMagic(const char* p, const char* end)
+{
+    char magic[4];
+    putLe32(magic, CompressedBlockHeader::kMagic);
+    while (end - p >= 4) {
+        const char* hit = static_cast<const char*>(memchr(p, magic[0], end - p - 3));
+        if (!hit) {
+            break;
+        }
+        if (memcmp(hit, magic, 4) == 0) {
+            return hit;
+        }
+        p = hit + 1;
+    }
+    return end;
+}
+
+} // namespace
+
+void CompressedBlockHeader::encode(char* out) const
+{
+    putLe32(out, magic_);
+    putLe32(out + 4, rawLen_);
+    putLe32(out + 8, storedLen_);
+    putLe32(out + 12, crc_);
+}
+
+void CompressedBlockHeader::decode(const char* in)
+{
+    magic_ = getLe32(in);
+    rawLen_ = getLe32(in + 4);
+    storedLen_ = getLe32(in + 8);
+    crc_ = getLe32(in + 12);
+}
+
+bool writeCompressedBlock(FILE* fp, const char* raw, size_t len)
+{
+    assert(len <= CompressedBlockHeader::kMaxBlockSize);
+    std::unique_ptr<char[]> out(new char[lzCompressBound(len)]);
+    size_t compressed = lzCompress(raw, len, out.get());
+
+    CompressedBlockHeader header;
+    header.magic_ = CompressedBlockHeader::kMagic;
+    header.rawLen_ = static_cast<uint32_t>(len);
+    header.crc_ = crc32(reinterpret_cast<const unsigned char*>(raw), static_cast<unsigned int>(len));
+    const char* payload = out.get();
+    if (compressed >= len) {
+        // 压缩后反而变大，按原文存储
+        header.storedLen_ = static_cast<uint32_t>(len) | CompressedBlockHeader::kRawFlag;
+        payload = raw;
+        compressed = len;
+    } else {
+        header.storedLen_ = static_cast<uint32_t>(compressed);
+    }
+    // 头和数据连续写出，尽量不留下半个块
+    char encoded[CompressedBlockHeader::kSize];
+    header.encode(encoded);
+    return fwrite(encoded, 1, sizeof encoded, fp) == sizeof encoded
+        && fwrite(payload, 1, compressed, fp) == compressed;
+}
+
+bool compressLogFile(const std::string& src, const std::string& dst, size_t blockSize)
+{
+    FILE* in = fopen(src.c_str(), "rb");
+    if (!in) {
+        fprintf(stderr, "compressLogFile: open %s failed: %s\n", src.c_str(), strerror(errno));
+        return false;
+    }
+    FILE* out = fopen(dst.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "compressLogFile: open %s failed: %s\n", dst.c_str(), strerror(errno));
+        fclose(in);
+        return false;
+    }
+    std::unique_ptr<char[]> buf(new char[blockSize]);
+    bool ok = true;
+    size_t n;
+    while (ok && (n = fread(buf.get(), 1, blockSize, in)) > 0) {
+        ok = writeCompressedBlock(out, buf.get(), n);
+    }
+    ok = ok && !ferror(in);
+    fclose(in);
+    ok = (fclose(out) == 0) && ok;
+    return ok;
+}
+
+long decompressLogFile(const std::string& src, FILE* out)
+{
+    FILE* fp = fopen(src.c_str(), "rb");
+    if (!fp) {
+        fprintf(stderr, "decompressLogFile: open %s failed: %s\n", src.c_str(), strerror(errno));
+        return -1;
+    }
+    std::vector<char> data;
+    char chunk[64 * 1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof chunk, fp)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(fp);
+
+    long corrupted = 0;
+    std::vector<char> raw;
+    const char* p = data.data();
+    const char* const end = p + data.size();
+    while (p < end) {
+        CompressedBlockHeader header;
+        bool ok = static_cast<size_t>(end - p) >= CompressedBlockHeader::kSize;
+        if (ok) {
+            header.decode(p);
+            uint32_t stored = header.storedLen_ & ~CompressedBlockHeader::kRawFlag;
+            ok = header.magic_ == CompressedBlockHeader::kMagic
+                && header.rawLen_ <= CompressedBlockHeader::kMaxBlockSize
+                && stored <= static_cast<size_t>(end - p) - CompressedBlockHeader::kSize;
+            if (ok) {
+                const char* payload = p + CompressedBlockHeader::kSize;
+                raw.resize(header.rawLen_);
+                if (header.storedLen_ & CompressedBlockHeader::kRawFlag) {
+                    ok = stored == header.rawLen_;
+                    if (ok) {
+                        memcpy(raw.data(), payload, stored);
+                    }
+                } else {
+                    ok = lzDecompress(payload, stored, raw.data(), header.rawLen_);
+                }
+                ok = ok && crc32(reinterpret_cast<const unsigned char*>(raw.data()), header.rawLen_) == header.crc_;
+                if (ok) {
+                    fwrite(raw.data(), 1, raw.size(), out);
+                    p = payload + stored;
+                    continue;
+                }
+            }
+        }
+        ++corrupted;
+        const char* next = findMagic(p + 1, end);
+        fprintf(stderr, "decompressLogFile: %s: corrupted block at offset %ld, skipped %ld bytes\n",
+            src.c_str(), static_cast<long>(p - data.data()), static_cast<long>(next - p));
+        p = next;
+    }
+    return corrupted;
+}
+
+CompressedLogSink::CompressedLogSink(const std::string& filename, size_t blockSize)
+    : blockSize_(blockSize < CompressedBlockHeader::kMaxBlockSize ? blockSize : CompressedBlockHeader::kMaxBlockSize)
+    , fp_(fopen(filename.c_str(), "ab"))
+    , submitted_(0)
+    , done_(0)
+    , pool_("CompressedLogSink")
+{
+    if (!fp_) {
+        fprintf(stderr, "CompressedLogSink: open %s failed: %s\n", filename.c_str(), strerror(errno));
+    }
+    current_.reserve(blockSize_);
+    pool_.setMaxQueueSize(kMaxQueuedTasks);
+    pool_.start(1);
+}
+
+CompressedLogSink::~CompressedLogSink()
+{
+    flush();
+    waitIdle();
+    if (fp_) {
+        fclose(fp_);
+    }
+}
+
+void CompressedLogSink::append(const char* data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    while (len > 0) {
+        size_t n = blockSize_ - current_.size();
+        if (n > len) {
+            n = len;
+        }
+        current_.append(data, n);
+        data += n;
+        len -= n;
+        if (current_.size() >= blockSize_) {
+            submit_locked(false);
+        }
+    }
+}
+
+void CompressedLogSink::flush()
+{
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(appendMutex_);
+        submit_locked(true);
+        ticket = submitted_;
+    }
+    waitFor(ticket);
+}
+
+void CompressedLogSink::waitIdle()
+{
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(appendMutex_);
+        ticket = submitted_;
+    }
+    waitFor(ticket);
+}
+
+// 等到第 ticket 个任务(及之前的任务)完成
+void CompressedLogSink::waitFor(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (done_ < ticket) {
+        idle_.wait(lock);
+    }
+}
+
+void CompressedLogSink::compressFileAsync(const std::string& src)
+{
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    ++submitted_;
+    size_t blockSize = blockSize_;
+    pool_.run([this, src, blockSize]() {
+        if (compressLogFile(src, src + ".wnz", blockSize)) {
+            remove(src.c_str());
+        }
+        taskDone();
+    });
+}
+
+void CompressedLogSink::submit_locked(bool flushAfter)
+{
+    if (!fp_ || (current_.empty() && !flushAfter)) {
+        return;
+    }
+    // std::function 要求可拷贝，用 shared_ptr 持有块数据；交换出去避免复制
+    auto block = std::make_shared<std::string>();
+    block->swap(current_);
+    current_.reserve(blockSize_);
+    ++submitted_;
+    FILE* fp = fp_;
+    // 单线程池按提交顺序执行，块在文件中的顺序与日志顺序一致。
+    // 队列满时在这里阻塞，直到后台写完一块；后台线程只取 mutex_，不会反过来等 appendMutex_
+    pool_.run([this, fp, block, flushAfter]() {
+        if (!block->empty() && !writeCompressedBlock(fp, block->data(), block->size())) {
+            fprintf(stderr, "CompressedLogSink: write failed: %s\n", strerror(errno));
+        }
+        if (flushAfter) {
+            fflush(fp);
+        }
+        taskDone();
+    });
+}
+
+void CompressedLogSink::taskDone()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++done_;
+    idle_.notify_all();
+}
@@ -0,0 +1,91 @@
+#ifndef WNCOMPRESSLOG_H
+#define WNCOMPRESSLOG_H
+
+#include "../wnthreadpool/wnthreadpool.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// 压缩日志的块格式。每块自带长度和校验，可以独立解码：
+// 崩溃时最多损坏最后一块，读取端可跳到下一个 magic 继续。
+//
+// | magic 'WNZ1' | rawLen u32 | storedLen u32 | crc32(原文) u32 | 数据 storedLen 字节 |
+//
+// storedLen 最高位为 1 表示数据不可压缩，按原文存储。整数均为小端，由 encode/decode 逐字节转换，
+// 与主机字节序无关。
+struct CompressedBlockHeader {
+    static constexpr uint32_t kMagic = 0x315A4E57; // "WNZ1"
+    static constexpr uint32_t kRawFlag = 0x80000000u;
+    static constexpr uint32_t kMaxBlockSize = 16 * 1024 * 1024;
+    static constexpr size_t kSize = 16; // 编码后的字节数
+
+    uint32_t magic_;
+    uint32_t rawLen_;
+    uint32_t storedLen_;
+    uint32_t crc_;
+
+    // 按小端写出 kSize 字节
+    void encode(char* out) const;
+    // 从 kSize 字节按小端读入
+    void decode(const char* in);
+};
+
+// 压缩 raw 并以一个块写入 fp
+bool writeCompressedBlock(FILE* fp, const char* raw, size_t len);
+
+// 把明文日志 src 按块压缩为 dst
+bool compressLogFile(const std::string& src, const std::string& dst, size_t blockSize = 256 * 1024);
+
+// 把压缩日志 src 解压写到 out。损坏的块报告到 stderr 后跳到下一个 magic 继续。
+// 返回损坏的块数，读文件失败返回 -1
+long decompressLogFile(const std::string& src, FILE* out);
+
+// 后台压缩的日志输出：调用方只做一次内存追加，
+// 凑满一块后交给专用的单线程 ThreadPool 压缩并写盘(单线程保证块的顺序)。
+// 最多 kMaxQueuedTasks 个任务排队，压缩跟不上写日志的速度时 append 阻塞等待，内存占用有上限。
+//
+// 用法:
+//   CompressedLogSink* g_sink = new CompressedLogSink("app.log.wnz");
+//   Logger::setOutput([](const char* msg, int len) { g_sink->append(msg, len); });
+//   Logger::setFlush([]() { g_sink->flush(); });
+//
+// 依赖线程池，链接时需要同时编译 ../wnthreadpool/wnthreadpool.cc
+class CompressedLogSink : noncopyable {
+public:
+    static constexpr int kMaxQueuedTasks = 8;
+
+    explicit CompressedLogSink(const std::string& filename, size_t blockSize = 256 * 1024);
+    // 等待所有块写完
+    ~CompressedLogSink();
+
+    bool ok() const { return fp_ != nullptr; }
+    void append(const char* data, size_t len);
+    // 提交当前未满的块，阻塞到它(以及之前提交的块)写完并 fflush 之后才返回。
+    // 可以直接用作 Logger::setFlush：FATAL 日志在 abort() 之前已经落盘
+    void flush();
+    // 阻塞直到已提交的任务全部完成
+    void waitIdle();
+    // 在后台线程把已轮转的明文日志 src 压缩为 src + ".wnz"，成功后删除 src
+    void compressFileAsync(const std::string& src);
+
+private:
+    void submit_locked(bool flushAfter);
+    void taskDone();
+    void waitFor(uint64_t ticket);
+
+    const size_t blockSize_;
+    FILE* fp_;
+    std::mutex appendMutex_; // 保护 current_、submitted_，并保证按 ticket 顺序入队
+    std::mutex mutex_; // 保护 done_，后台线程只取这把锁
+    std::condition_variable idle_;
+    std::string current_;
+    // 单线程池按提交顺序执行，两者之差即已提交未完成的任务数
+    uint64_t submitted_;
+    uint64_t done_;
+    ThreadPool pool_;
+};
+
+#endif // WNCOMPRESSLOG_H
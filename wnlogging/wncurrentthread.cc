@@ -0,0 +1,70 @@
+#include "wncurrentthread.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace CurrentThread {
+
+thread_local int t_cachedTid = 0;
+thread_local char t_tidString[64];
+thread_local int t_tidStringLength = 0;
+thread_local char t_threadName[16] = "";
+
+namespace {
+
+void formatTidString()
+{
+    if (t_threadName[0] != '\0') {
+        t_tidStringLength = snprintf(t_tidString, sizeof t_tidString,
+            "[threadID:%d %s] ", t_cachedTid, t_threadName);
+    } else {
+        t_tidStringLength = snprintf(t_tidString, sizeof t_tidString,
+            "[threadID:%d] ", t_cachedTid);
+    }
+}
+
+// fork 后子进程只剩调用 fork 的线程，其 tid 已经变了
+void afterFork()
+{
+    t_cachedTid = 0;
+}
+
+class ThreadIdInitializer {
+public:
+    ThreadIdInitializer()
+    {
+        pthread_atfork(nullptr, nullptr, &afterFork);
+    }
+};
+
+ThreadIdInitializer init;
+
+} // namespace
+
+void cacheTid()
+{
+    if (t_cachedTid == 0) {
+        t_cachedTid = static_cast<int>(::syscall(SYS_gettid));
+        formatTidString();
+    }
+}
+
+void setName(const char* name)
+{
+    tid();
+    strncpy(t_threadName, name ? name : "", sizeof t_threadName - 1);
+    t_threadName[sizeof t_threadName - 1] = '\0';
+    pthread_setname_np(pthread_self(), t_threadName);
+    formatTidString();
+}
+
+const char* name()
+{
+    return t_threadName;
+}
+
+} // namespace CurrentThread
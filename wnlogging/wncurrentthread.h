@@ -0,0 +1,41 @@
+#ifndef WNCURRENTTHREAD_H
+#define WNCURRENTTHREAD_H
+
+// 当前线程的信息，全部缓存在线程局部存储中。
+// tid 为内核线程号(gettid)，与 top / perf / ps -L 中看到的一致。
+namespace CurrentThread {
+
+extern thread_local int t_cachedTid;
+// 预先格式化好的日志前缀，如 "[threadID:12345] " 或 "[threadID:12345 worker] "
+extern thread_local char t_tidString[64];
+extern thread_local int t_tidStringLength;
+
+void cacheTid();
+
+inline int tid()
+{
+    if (__builtin_expect(t_cachedTid == 0, 0)) {
+        cacheTid();
+    }
+    return t_cachedTid;
+}
+
+inline const char* tidString()
+{
+    tid();
+    return t_tidString;
+}
+
+inline int tidStringLength()
+{
+    tid();
+    return t_tidStringLength;
+}
+
+// 设置当前线程名：写入日志前缀，并同步给内核(最多 15 字节)，便于 top -H 查看
+void setName(const char* name);
+const char* name();
+
+} // namespace CurrentThread
+
+#endif // WNCURRENTTHREAD_H
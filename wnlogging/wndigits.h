@@ -0,0 +1,130 @@
+#ifndef WNDIGITS_H
+#define WNDIGITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 十进制整数的格式化与解析内核。纯头文件，LogStream 与 Wnstring 共用同一份查表。
+namespace detail {
+
+// "00" "01" ... "99"：每次除以 100 写出两位，除法次数减半
+inline constexpr char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+static_assert(sizeof kDigitPairs == 201, "wrong number of digit pairs");
+
+// 十进制位数。每轮比较 4 个区间再除一次 10000
+inline size_t countDigits(uint64_t v)
+{
+    size_t n = 1;
+    for (;;) {
+        if (v < 10) {
+            return n;
+        }
+        if (v < 100) {
+            return n + 1;
+        }
+        if (v < 1000) {
+            return n + 2;
+        }
+        if (v < 10000) {
+            return n + 3;
+        }
+        v /= 10000;
+        n += 4;
+    }
+}
+
+// 先算出位数，再从末尾两位一组倒着写，不需要 reverse。不补 '\0'，返回长度(最多 20)
+inline size_t formatUnsigned(char* buf, uint64_t v)
+{
+    const size_t len = countDigits(v);
+    char* p = buf + len;
+    while (v >= 100) {
+        const size_t r = static_cast<size_t>(v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        memcpy(p, kDigitPairs + r, 2);
+    }
+    if (v >= 10) {
+        memcpy(p - 2, kDigitPairs + v * 2, 2);
+    } else {
+        p[-1] = static_cast<char>('0' + v);
+    }
+    return len;
+}
+
+// 最多 20 个字符(含 '-')
+inline size_t formatSigned(char* buf, int64_t v)
+{
+    if (v < 0) {
+        *buf = '-';
+        // 先转无符号再取负，INT64_MIN 也不会溢出
+        return formatUnsigned(buf + 1, 0 - static_cast<uint64_t>(v)) + 1;
+    }
+    return formatUnsigned(buf, static_cast<uint64_t>(v));
+}
+
+// SWAR：8 个 ASCII 字节是否都是 '0'~'9'。高半字节必须是 3，且加 6 后不进位到高半字节
+inline bool isEightDigits(uint64_t v)
+{
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+        == 0x3333333333333333ULL;
+}
+
+// SWAR：把小端读入的 8 个数字字符转成整数，3 次乘法代替 8 次乘加
+inline uint32_t parseEightDigits(uint64_t v)
+{
+    v -= 0x3030303030303030ULL;
+    v = v * 10 + (v >> 8); // 相邻两位合并
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+            + (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))))
+        >> 32;
+    return static_cast<uint32_t>(v);
+}
+
+// 从 s 开始解析连续的十进制数字，返回消耗的字符数(0 表示没有数字)。
+// 超出 uint64_t 时 *overflow 置 true，仍然消耗完所有数字
+inline size_t parseUnsigned(const char* s, size_t n, uint64_t* out, bool* overflow)
+{
+    uint64_t value = 0;
+    size_t i = 0;
+    *overflow = false;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i + 8 <= n; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, s + i, sizeof chunk);
+        if (!isEightDigits(chunk)) {
+            break;
+        }
+        if (__builtin_mul_overflow(value, 100000000ULL, &value)
+            || __builtin_add_overflow(value, parseEightDigits(chunk), &value)) {
+            *overflow = true;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const unsigned d = static_cast<unsigned char>(s[i]) - '0';
+        if (d > 9) {
+            break;
+        }
+        if (__builtin_mul_overflow(value, 10ULL, &value) || __builtin_add_overflow(value, d, &value)) {
+            *overflow = true;
+        }
+    }
+    *out = value;
+    return i;
+}
+
+} // namespace detail
+
+#endif // WNDIGITS_H
@@ -0,0 +1,98 @@
+#ifndef WNHEX_H
+#define WNHEX_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// 十六进制编码内核：n 字节写出 2n 个字符(不补 '\0')。
+// 运行时选择 AVX2 / SSE2 / 标量实现。纯头文件。
+namespace detail {
+
+inline void hexEncodeScalar(char* dst, const unsigned char* src, size_t n, bool upper)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    for (size_t i = 0; i < n; ++i) {
+        dst[2 * i] = digits[src[i] >> 4];
+        dst[2 * i + 1] = digits[src[i] & 0xF];
+    }
+}
+
+#if defined(__SSE2__)
+// 半字节 n 转 ASCII: n + '0'，n > 9 时再加上到 'a'/'A' 的差值。SSE2 没有 pshufb，用比较+掩码代替查表
+inline __m128i hexNibblesSse2(__m128i n, __m128i alphaOffset)
+{
+    __m128i gt9 = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), _mm_and_si128(gt9, alphaOffset));
+}
+
+inline void hexEncodeSse2(char* dst, const unsigned char* src, size_t n, bool upper)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i alphaOffset = _mm_set1_epi8(upper ? 'A' - '9' - 1 : 'a' - '9' - 1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = hexNibblesSse2(_mm_and_si128(_mm_srli_epi16(b, 4), mask), alphaOffset);
+        __m128i lo = hexNibblesSse2(_mm_and_si128(b, mask), alphaOffset);
+        // 交错高低半字节：hi0 lo0 hi1 lo1 ...
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    hexEncodeScalar(dst + 2 * i, src + i, n - i, upper);
+}
+
+__attribute__((target("avx2")))
+inline __m256i hexNibblesAvx2(__m256i n, __m256i alphaOffset)
+{
+    __m256i gt9 = _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9));
+    return _mm256_add_epi8(_mm256_add_epi8(n, _mm256_set1_epi8('0')), _mm256_and_si256(gt9, alphaOffset));
+}
+
+__attribute__((target("avx2")))
+inline void hexEncodeAvx2(char* dst, const unsigned char* src, size_t n, bool upper)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i alphaOffset = _mm256_set1_epi8(upper ? 'A' - '9' - 1 : 'a' - '9' - 1);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i hi = hexNibblesAvx2(_mm256_and_si256(_mm256_srli_epi16(b, 4), mask), alphaOffset);
+        __m256i lo = hexNibblesAvx2(_mm256_and_si256(b, mask), alphaOffset);
+        // AVX2 的 unpack 在两个 128 位通道内各自进行，需要再交换通道恢复顺序
+        __m256i a = _mm256_unpacklo_epi8(hi, lo); // 字节 0-7 | 16-23
+        __m256i c = _mm256_unpackhi_epi8(hi, lo); // 字节 8-15 | 24-31
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), _mm256_permute2x128_si256(a, c, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 32), _mm256_permute2x128_si256(a, c, 0x31));
+    }
+    hexEncodeSse2(dst + 2 * i, src + i, n - i, upper);
+}
+#endif
+
+typedef void (*HexEncodeFunc)(char*, const unsigned char*, size_t, bool);
+
+inline HexEncodeFunc resolveHexEncode()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return hexEncodeAvx2;
+    }
+    return hexEncodeSse2;
+#else
+    return hexEncodeScalar;
+#endif
+}
+
+inline void hexEncode(char* dst, const void* src, size_t n, bool upper = false)
+{
+    static const HexEncodeFunc func = resolveHexEncode();
+    func(dst, static_cast<const unsigned char*>(src), n, upper);
+}
+
+} // namespace detail
+
+#endif // WNHEX_H
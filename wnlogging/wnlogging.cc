@@ -1,6 +1,7 @@
 
 
 #include "wnlogging.h"
+#include "wncurrentthread.h"
 
 #include <cerrno>
 #include <cstdio>
@@ -8,7 +9,6 @@
 
 #include <iostream>
 #include <sstream>
-#include <thread>
 
 
 const char* LogLevelName[Logger::NUM_LOG_LEVELS] = {
@@ -56,43 +56,81 @@ void defaultOutput(const char* msg, int len)
     }
 }
 
+void defaultOutputV(const struct iovec* iov, int iovcnt)
+{
+    // 加锁保证一条记录的各段连续写出，不被其他线程插入
+    flockfile(stdout);
+    for (int i = 0; i < iovcnt; ++i) {
+        fwrite_unlocked(iov[i].iov_base, 1, iov[i].iov_len, stdout);
+    }
+    funlockfile(stdout);
+}
+
 void defaultFlush()
 {
     // 刷新stdout写入文件
     fflush(stdout);
 }
 
+// 时间前缀按秒缓存在线程局部存储中，同一秒内的日志直接 memcpy
+thread_local time_t t_lastSecond = -1;
+thread_local char t_time[16];
+// strerror_r 的输出缓冲，避免 strerror 对未知 errno 分配内存
+thread_local char t_errnobuf[512];
+
 Logger::OutputFunc g_output = defaultOutput;
+Logger::OutputVFunc g_outputv = defaultOutputV;
 Logger::FlushFunc g_flush = defaultFlush;
 
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file, int line)
-    : stream_(), level_(level), line_(line), basename_(file)
+    : stream_(), level_(level), line_(line), basename_(file), site_(nullptr)
+{
+    formatPrefix(LogLevelName[level], savedErrno);
+}
+
+Logger::Impl::Impl(const Site& site, int savedErrno)
+    : stream_()
+    , level_(site.level_)
+    , line_(site.line_)
+    , basename_(site.basename_, site.basenameLen_)
+    , site_(&site)
+{
+    formatPrefix(site.levelName_, savedErrno);
+}
+
+void Logger::Impl::formatPrefix(const char* levelName, int savedErrno)
 {
     formatTime();
 
-    stream_ << T(LogLevelName[level], 7);
+    stream_ << T(levelName, 7);
 
-    std::thread::id threadId = std::this_thread::get_id();
-    int* pi = (int*)&threadId;
-    stream_ << "[threadID:" << *pi << "] ";
+    stream_.append(CurrentThread::tidString(), CurrentThread::tidStringLength());
 
     if (savedErrno != 0) {
-        stream_ << strerror(savedErrno) << "(errno=" << savedErrno << ") ";
+        stream_ << strerror_r(savedErrno, t_errnobuf, sizeof t_errnobuf) << "(errno=" << savedErrno << ") ";
     }
 }
 
 void Logger::Impl::formatTime()
 {
     time_t t = time(0);
-    char tmp[11];
-    strftime(tmp, sizeof(tmp), "[%H:%M:%S]", localtime(&t));
-    time_ = tmp;
-    stream_ << time_;
+    if (t != t_lastSecond) {
+        struct tm tm;
+        localtime_r(&t, &tm);
+        strftime(t_time, sizeof(t_time), "[%H:%M:%S]", &tm);
+        t_lastSecond = t;
+    }
+    stream_.append(t_time, 10);
 }
 
 void Logger::Impl::finish()
 {
+    stream_.finishKv();
+    if (site_) {
+        stream_.append(site_->suffix_, site_->suffixLen_);
+        return;
+    }
     if (level_ == Logger::DEBUG)
         stream_ << " [" << __DATE__ << " " << __TIME__ << "]"; //编译时间
     stream_ << " --" << basename_ << ':' << line_ << '\n';
@@ -110,11 +148,32 @@ Logger::Logger(SourceFile file, int line, bool toAbort, const char* func)
     impl_.stream_ << "[fuc:" << func << "] msg: ";
 }
 
+Logger::Logger(const Site& site, const char* func, int funcLen, bool withErrno)
+    : impl_(site, withErrno ? errno : 0)
+{
+    impl_.stream_.append("[fuc:", 5);
+    impl_.stream_.append(func, funcLen);
+    impl_.stream_.append("] msg: ", 7);
+}
+
 Logger::~Logger()
 {
     impl_.finish();
     const LogStream::Buffer& buf(stream().buffer());
-    g_output(buf.data(), buf.length());
+    if (!buf.spilled()) {
+        g_output(buf.data(), buf.length());
+    } else if (g_outputv) {
+        struct iovec iov[1 + detail::kMaxSpillBlocks];
+        int n = 0;
+        buf.forEachChunk([&iov, &n](const char* p, int len) {
+            iov[n].iov_base = const_cast<char*>(p);
+            iov[n].iov_len = len;
+            ++n;
+        });
+        g_outputv(iov, n);
+    } else {
+        buf.forEachChunk([](const char* p, int len) { g_output(p, len); });
+    }
     if (impl_.level_ == FATAL) {
         g_flush();
         abort();
@@ -124,6 +183,12 @@ Logger::~Logger()
 void Logger::setOutput(OutputFunc out)
 {
     g_output = out;
+    g_outputv = nullptr;
+}
+
+void Logger::setOutputV(OutputVFunc out)
+{
+    g_outputv = out;
 }
 
 void Logger::setFlush(FlushFunc flush)
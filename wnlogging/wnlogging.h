@@ -3,6 +3,8 @@
 
 #include "wnlogstream.h"
 
+#include <sys/uio.h> // iovec
+
 
 class Logger {
 public:
@@ -38,20 +40,102 @@ public:
             size_ = static_cast<int>(strlen(data_));
         }
 
+        // 已经是 basename 且长度已知
+        SourceFile(const char* basename, int size): data_(basename), size_(size) {}
+
         const char* data_;
         int size_;
     };
 
+    // 调用点的静态信息：文件名、行号、级别以及整段尾部 " --file:line\n"
+    // 都在编译期算好，每条日志只需 memcpy。
+    // 每个调用点有唯一的 constexpr 实例，其地址可作为调用点 ID。
+    class Site {
+    public:
+        static constexpr int kMaxSuffix = 128;
+
+        constexpr Site(const char* file, int line, LogLevel level)
+            : level_(level)
+            , line_(line)
+            , levelName_(levelName(level))
+            , basename_(file)
+            , basenameLen_(0)
+            , suffix_ {}
+            , suffixLen_(0)
+        {
+            for (const char* p = file; *p; ++p) {
+                if (*p == '/') {
+                    basename_ = p + 1;
+                }
+            }
+            while (basename_[basenameLen_]) {
+                ++basenameLen_;
+            }
+
+            if (level == DEBUG) {
+                appendSuffix(" [" __DATE__ " " __TIME__ "]"); //编译时间
+            }
+            appendSuffix(" --");
+            appendSuffix(basename_);
+            appendSuffix(":");
+            char digits[16] = {};
+            int n = 0;
+            for (int v = line; v > 0 || n == 0; v /= 10) {
+                digits[n++] = static_cast<char>('0' + v % 10);
+            }
+            while (n > 0 && suffixLen_ < kMaxSuffix - 1) {
+                suffix_[suffixLen_++] = digits[--n];
+            }
+            // 文件名过长被截断时也保证以换行结尾
+            suffix_[suffixLen_++] = '\n';
+        }
+
+        const void* id() const { return this; }
+
+        static constexpr const char* levelName(LogLevel level)
+        {
+            return level == DEBUG ? " DEBUG "
+                : level == INFO   ? " INFO  "
+                : level == WARN   ? " WARN  "
+                : level == ERROR  ? " ERROR "
+                                  : " FATAL ";
+        }
+
+        LogLevel level_;
+        int line_;
+        const char* levelName_; // 固定 7 字节
+        const char* basename_;
+        int basenameLen_;
+        char suffix_[kMaxSuffix];
+        int suffixLen_;
+
+    private:
+        constexpr void appendSuffix(const char* str)
+        {
+            // 留一个字节给结尾的换行
+            while (*str && suffixLen_ < kMaxSuffix - 1) {
+                suffix_[suffixLen_++] = *str++;
+            }
+        }
+    };
+
     Logger(SourceFile file, int line, LogLevel level, const char* func);
     // 错误流用
     Logger(SourceFile file, int line, bool toAbort, const char* func);
+    // LOG_* 宏使用：funcLen 由 sizeof(__func__) 在编译期给出，省去 strlen
+    Logger(const Site& site, const char* func, int funcLen, bool withErrno = false);
     ~Logger();
 
     LogStream& stream() { return impl_.stream_; }
 
     typedef void (*OutputFunc)(const char* msg, int len);
+    // 超长记录(含溢出块)分段写出，一条记录一次调用，语义同 writev
+    typedef void (*OutputVFunc)(const struct iovec* iov, int iovcnt);
     typedef void (*FlushFunc)();
+    // setOutput 会清空 OutputV，超长记录将按段多次调用 OutputFunc；
+    // 需要整条原子写出时在其后调用 setOutputV
     static void setOutput(OutputFunc);
+    static void setOutputV(OutputVFunc);
     static void setFlush(FlushFunc);
 
 private:
@@ -60,14 +144,16 @@ private:
     public:
         typedef Logger::LogLevel LogLevel;
         Impl(LogLevel level, int old_errno, const SourceFile& file, int line);
+        Impl(const Site& site, int old_errno);
+        void formatPrefix(const char* levelName, int savedErrno);
         void formatTime(); //格式化时间
         void finish(); // 用于析构函数将缓存写入流文件
 
-        std::string time_;
         LogStream stream_;
         LogLevel level_;
         int line_;
         SourceFile basename_;
+        const Site* site_; // 经由 LOG_* 宏构造时非空
     };
 
     Impl impl_;
@@ -91,13 +177,23 @@ private:
 //     logWarnStream << "Bad news";
 //
 
-#define LOG_DEBUG Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream()
-#define LOG_INFO Logger(__FILE__, __LINE__, Logger::INFO, __func__).stream()
-#define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN, __func__).stream()
-#define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR, __func__).stream()
-#define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL, __func__).stream()
-#define LOG_SYSERR Logger(__FILE__, __LINE__, false, __func__).stream()
-#define LOG_SYSFATAL Logger(__FILE__, __LINE__, true, __func__).stream()
+// 每个 lambda 表达式都是独立类型，其中的 static constexpr 就是该调用点私有的 Site，
+// 常量初始化，运行期没有任何构造开销。
+#define WN_LOG_SITE(level) \
+    ([]() -> const Logger::Site& { \
+        static constexpr Logger::Site wnLogSite_(__FILE__, __LINE__, level); \
+        return wnLogSite_; }())
+
+#define WN_LOG_AT(level, withErrno) \
+    Logger(WN_LOG_SITE(level), __func__, sizeof(__func__) - 1, withErrno)
+
+#define LOG_DEBUG WN_LOG_AT(Logger::DEBUG, false).stream()
+#define LOG_INFO WN_LOG_AT(Logger::INFO, false).stream()
+#define LOG_WARN WN_LOG_AT(Logger::WARN, false).stream()
+#define LOG_ERROR WN_LOG_AT(Logger::ERROR, false).stream()
+#define LOG_FATAL WN_LOG_AT(Logger::FATAL, false).stream()
+#define LOG_SYSERR WN_LOG_AT(Logger::ERROR, true).stream()
+#define LOG_SYSFATAL WN_LOG_AT(Logger::FATAL, true).stream()
 
 // Taken from glog/logging.h
 //
@@ -117,6 +213,6 @@ T* CheckNotNull(Logger::SourceFile file, int line, const char* names, T* ptr)
     return ptr;
 }
 
-
+#include "wnlogratelimit.h"
 
 #endif // LOGGING_H
@@ -0,0 +1,155 @@
+#ifndef WNLOGRATELIMIT_H
+#define WNLOGRATELIMIT_H
+
+#include "wnlogstream.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+// 每个调用点各自持有一份限流状态（函数内 static，无共享锁）。
+// 消息被丢弃时只做一次 relaxed 原子操作；下一条放行的消息会带上
+// "[suppressed N] " 前缀，报告期间被丢弃的条数。
+
+namespace detail {
+
+// CLOCK_MONOTONIC_COARSE 走 vDSO，不陷入内核，精度(ms级)对限流足够
+inline int64_t coarseNowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 每 n 条放行一条（第 1、n+1、2n+1 ... 条）
+class LogEveryNState {
+public:
+    constexpr LogEveryNState(): count_(0) {}
+
+    bool shouldLog(long n, long* suppressed)
+    {
+        uint64_t c = count_.fetch_add(1, std::memory_order_relaxed);
+        if (n <= 1) {
+            return true;
+        }
+        if (c % static_cast<uint64_t>(n) != 0) {
+            return false;
+        }
+        // 两次放行之间恰好丢弃 n-1 条，不需要额外计数
+        *suppressed = (c == 0) ? 0 : n - 1;
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+};
+
+// 只放行前 n 条
+class LogFirstNState {
+public:
+    constexpr LogFirstNState(): count_(0) {}
+
+    bool shouldLog(long n, long*)
+    {
+        // 超额后只读不写，避免热点缓存行被反复争抢
+        if (count_.load(std::memory_order_relaxed) >= static_cast<uint64_t>(n)) {
+            return false;
+        }
+        return count_.fetch_add(1, std::memory_order_relaxed) < static_cast<uint64_t>(n);
+    }
+
+private:
+    std::atomic<uint64_t> count_;
+};
+
+// 每 seconds 秒最多放行一条
+class LogEveryTState {
+public:
+    constexpr LogEveryTState(): next_(0), suppressed_(0) {}
+
+    bool shouldLog(double seconds, long* suppressed)
+    {
+        int64_t now = coarseNowNanos();
+        int64_t next = next_.load(std::memory_order_relaxed);
+        // 同一时间窗口内只有抢到 CAS 的线程能放行
+        if (now < next || !next_.compare_exchange_strong(next,
+                              now + static_cast<int64_t>(seconds * 1e9),
+                              std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> next_;
+    std::atomic<long> suppressed_;
+};
+
+// 以概率 rate(0~1) 随机放行。随机数来自线程局部的 xorshift，不碰任何共享状态
+class LogSampledState {
+public:
+    constexpr LogSampledState(): suppressed_(0) {}
+
+    bool shouldLog(double rate, long* suppressed)
+    {
+        if (static_cast<double>(nextRandom() >> 11) * 0x1.0p-53 >= rate) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static uint64_t nextRandom()
+    {
+        static thread_local uint64_t state = 0;
+        if (state == 0) {
+            // 用线程局部变量地址做种子，乘黄金分割常数打散低熵位，保证各线程序列不同且非零
+            state = (reinterpret_cast<uintptr_t>(&state) * 0x9E3779B97F4A7C15ULL) | 1;
+        }
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    std::atomic<long> suppressed_;
+};
+
+} // namespace detail
+
+// 放行时输出被丢弃的条数，未丢弃时什么都不写
+struct LogSuppressed {
+    explicit LogSuppressed(long count): count_(count) {}
+    long count_;
+};
+
+inline LogStream& operator<<(LogStream& s, LogSuppressed v)
+{
+    if (v.count_ > 0) {
+        s << "[suppressed " << v.count_ << "] ";
+    }
+    return s;
+}
+
+// 每个 lambda 表达式都是独立的类型，其中的 static 就是该调用点私有的状态。
+// 状态类都有 constexpr 构造函数，属于常量初始化，没有 guard 变量的开销。
+#define WN_LOG_SITE_STATE(Type) \
+    ([]() -> Type& { static Type wnLogSiteState_; return wnLogSiteState_; }())
+
+// 写成 if/else 链，避免 LOG_* 上方 CAUTION 中提到的悬挂 else 问题
+#define WN_LOG_RATE_LIMITED(severity, Type, arg) \
+    if (long wnLogSuppressed_ = 0) {} else \
+    if (!WN_LOG_SITE_STATE(detail::Type).shouldLog((arg), &wnLogSuppressed_)) {} else \
+    WN_LOG_AT(Logger::severity, false).stream() << LogSuppressed(wnLogSuppressed_)
+
+// 用法: LOG_EVERY_N(ERROR, 1000) << "bad packet";
+#define LOG_EVERY_N(severity, n) WN_LOG_RATE_LIMITED(severity, LogEveryNState, n)
+#define LOG_FIRST_N(severity, n) WN_LOG_RATE_LIMITED(severity, LogFirstNState, n)
+#define LOG_EVERY_T(severity, seconds) WN_LOG_RATE_LIMITED(severity, LogEveryTState, seconds)
+#define LOG_SAMPLED(severity, rate) WN_LOG_RATE_LIMITED(severity, LogSampledState, rate)
+
+#endif // WNLOGRATELIMIT_H
@@ -0,0 +1,189 @@
+#include "wnlogrecord.h"
+#include "../wncrypto/wncrc32.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace logrecord {
+
+const char kSyncMarker[kSyncSize] = {
+    '\xFF', '\xFF', '\xFF', '\xFF', 'W', 'N', 'S', 'Y',
+    'N', 'C', '\0', '\0', '\x5A', '\xA5', '\xC3', '\x3C'
+};
+
+} // namespace logrecord
+
+using namespace logrecord;
+
+BinaryLogWriter::BinaryLogWriter(const std::string& filename)
+    : fp_(nullptr), sinceSync_(kSyncInterval)
+{
+    // 截掉崩溃时残留的半条记录，保证新记录紧接在有效数据之后
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0 && st.st_size > 0) {
+        BinaryLogReader reader(filename);
+        uint64_t end = reader.validEnd();
+        if (end < static_cast<uint64_t>(st.st_size) && truncate(filename.c_str(), end) != 0) {
+            fprintf(stderr, "BinaryLogWriter: truncate %s failed: %s\n", filename.c_str(), strerror(errno));
+        }
+    }
+    fp_ = fopen(filename.c_str(), "ab");
+    if (!fp_) {
+        fprintf(stderr, "BinaryLogWriter: open %s failed: %s\n", filename.c_str(), strerror(errno));
+    }
+}
+
+BinaryLogWriter::~BinaryLogWriter()
+{
+    if (fp_) {
+        fclose(fp_);
+    }
+}
+
+void BinaryLogWriter::append(const char* data, size_t len)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = len;
+    appendv(&iov, 1);
+}
+
+void BinaryLogWriter::appendv(const struct iovec* iov, int iovcnt)
+{
+    size_t len = 0;
+    uint32_t crc = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        len += iov[i].iov_len;
+        crc = crc32Update(crc, static_cast<const unsigned char*>(iov[i].iov_base),
+            static_cast<unsigned int>(iov[i].iov_len));
+    }
+    if (len == 0 || len > kMaxRecordSize) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fp_) {
+        return;
+    }
+    writeHeader_locked(len, crc);
+    for (int i = 0; i < iovcnt; ++i) {
+        fwrite(iov[i].iov_base, 1, iov[i].iov_len, fp_);
+    }
+    sinceSync_ += kHeaderSize + len;
+}
+
+void BinaryLogWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fp_) {
+        fflush(fp_);
+    }
+}
+
+void BinaryLogWriter::writeHeader_locked(size_t len, uint32_t crc)
+{
+    if (sinceSync_ >= kSyncInterval) {
+        fwrite(kSyncMarker, 1, kSyncSize, fp_);
+        sinceSync_ = 0;
+    }
+    uint32_t header[2] = { static_cast<uint32_t>(len), crc };
+    fwrite(header, 1, kHeaderSize, fp_);
+}
+
+BinaryLogReader::BinaryLogReader(const std::string& filename)
+    : fd_(-1), base_(nullptr), size_(0), pos_(0), corrupted_(0)
+{
+    fd_ = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        fprintf(stderr, "BinaryLogReader: open %s failed: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        return;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "BinaryLogReader: mmap %s failed: %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    base_ = static_cast<const char*>(p);
+    size_ = st.st_size;
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+    if (base_) {
+        munmap(const_cast<char*>(base_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void BinaryLogReader::rewind()
+{
+    pos_ = 0;
+    corrupted_ = 0;
+}
+
+bool BinaryLogReader::atSyncMarker() const
+{
+    return size_ - pos_ >= kSyncSize && memcmp(base_ + pos_, kSyncMarker, kSyncSize) == 0;
+}
+
+bool BinaryLogReader::next(Record* rec)
+{
+    while (pos_ < size_) {
+        if (atSyncMarker()) {
+            pos_ += kSyncSize;
+            continue;
+        }
+        if (size_ - pos_ >= kHeaderSize) {
+            uint32_t header[2];
+            memcpy(header, base_ + pos_, kHeaderSize);
+            uint32_t len = header[0];
+            if (len != 0 && len != kSyncLen && len <= kMaxRecordSize && len <= size_ - pos_ - kHeaderSize) {
+                const char* payload = base_ + pos_ + kHeaderSize;
+                if (crc32(reinterpret_cast<const unsigned char*>(payload), len) == header[1]) {
+                    rec->data = payload;
+                    rec->len = len;
+                    rec->offset = pos_;
+                    pos_ += kHeaderSize + len;
+                    return true;
+                }
+            }
+        }
+        resync();
+    }
+    return false;
+}
+
+void BinaryLogReader::resync()
+{
+    uint64_t from = pos_;
+    const void* hit = memmem(base_ + pos_ + 1, size_ - pos_ - 1, kSyncMarker, kSyncSize);
+    pos_ = hit ? static_cast<const char*>(hit) - base_ : size_;
+    corrupted_ += pos_ - from;
+}
+
+uint64_t BinaryLogReader::validEnd()
+{
+    uint64_t end = pos_;
+    Record rec;
+    while (pos_ < size_) {
+        if (atSyncMarker()) {
+            pos_ += kSyncSize;
+            end = pos_;
+        } else if (next(&rec)) {
+            end = pos_;
+        }
+    }
+    return end;
+}
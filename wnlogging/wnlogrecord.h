@@ -0,0 +1,96 @@
+#ifndef WNLOGRECORD_H
+#define WNLOGRECORD_H
+
+#include "wnlogstream.h" // noncopyable
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include <sys/uio.h> // iovec
+
+// 可选的二进制日志记录格式：
+//
+// 记录:     | len u32 | crc32(payload) u32 | payload len 字节 |
+// 同步标记: | 0xFFFFFFFF | "WNSYNC\0\0" 后 4 字节 | 固定 16 字节
+//
+// len 为 0 的记录不写也不认：预分配或崩溃留下的全零尾部的头恰好是 len=0、crc32("")=0，
+// 否则会被当成一串空记录。
+// 文件开头以及之后每写满 kSyncInterval 字节插入一个同步标记。
+// 读到损坏的记录时向后查找下一个同步标记继续，崩溃后一遍扫描即可找到最后一条有效记录。
+// 整数均为小端。
+namespace logrecord {
+
+constexpr uint32_t kSyncLen = 0xFFFFFFFF;
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kSyncSize = 16;
+constexpr size_t kSyncInterval = 64 * 1024;
+// 超过此长度的 len 视为损坏，避免被垃圾长度带着跳过大量数据
+constexpr uint32_t kMaxRecordSize = 64 * 1024 * 1024;
+
+extern const char kSyncMarker[kSyncSize];
+
+} // namespace logrecord
+
+// 以记录格式追加写文件，线程安全。
+// 打开已存在的文件时先做恢复扫描，截掉末尾写了一半的记录。
+//
+// 用法:
+//   BinaryLogWriter* g_writer = new BinaryLogWriter("app.wlog");
+//   Logger::setOutput([](const char* msg, int len) { g_writer->append(msg, len); });
+//   Logger::setOutputV([](const struct iovec* iov, int cnt) { g_writer->appendv(iov, cnt); });
+class BinaryLogWriter : noncopyable {
+public:
+    explicit BinaryLogWriter(const std::string& filename);
+    ~BinaryLogWriter();
+
+    bool ok() const { return fp_ != nullptr; }
+    // 空数据不写
+    void append(const char* data, size_t len);
+    // 多段数据组成一条记录
+    void appendv(const struct iovec* iov, int iovcnt);
+    void flush();
+
+private:
+    void writeHeader_locked(size_t len, uint32_t crc);
+
+    std::mutex mutex_;
+    FILE* fp_;
+    size_t sinceSync_; // 距上一个同步标记写入的字节数
+};
+
+// 通过 mmap 零拷贝地遍历记录文件。Record::data 直接指向映射区，reader 析构前有效
+class BinaryLogReader : noncopyable {
+public:
+    struct Record {
+        const char* data;
+        uint32_t len;
+        uint64_t offset; // 记录头在文件中的偏移
+    };
+
+    explicit BinaryLogReader(const std::string& filename);
+    ~BinaryLogReader();
+
+    bool ok() const { return base_ != nullptr || size_ == 0; }
+    // 读取下一条有效记录，到末尾返回 false。损坏的数据会被跳过并计入 corruptedBytes()
+    bool next(Record* rec);
+    void rewind();
+    uint64_t corruptedBytes() const { return corrupted_; }
+    // 从当前位置扫描到末尾，返回最后一条有效记录(或同步标记)的结束偏移
+    uint64_t validEnd();
+
+private:
+    // pos_ 处是完整的同步标记
+    bool atSyncMarker() const;
+    // 从 pos_ 向后查找下一个同步标记，找不到时移到末尾
+    void resync();
+
+    int fd_;
+    const char* base_;
+    uint64_t size_;
+    uint64_t pos_;
+    uint64_t corrupted_;
+};
+
+#endif // WNLOGRECORD_H
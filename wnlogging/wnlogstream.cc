@@ -1,5 +1,7 @@
 
 #include "wnlogstream.h"
+#include "wndigits.h"
+#include "wnhex.h"
 
 #include <algorithm>
 #include <cassert>
@@ -8,62 +10,260 @@
 #include <cstdio>
 #include <type_traits>
 
-using namespace detail;
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-// TODO: better itoa.
+using namespace detail;
 
 namespace detail {
 
-const char digits[] = "9876543210123456789";
-const char *zero = digits + 9;
-static_assert(sizeof digits == 20, "wrong number of digits");
-
 const char digitsHex[] = "0123456789ABCDEF";
 static_assert(sizeof digitsHex == 17, "wrong number of digitsHex");
 
-// int 转字符串（ Matthew Wilson设计的“带符号整形数据的出发与余数”算法）
+// int 转字符串：两位一组查表，见 wndigits.h
 template <typename T>
 size_t convert(char buf[], T value)
 {
-    T i = value;
-    char* p = buf;
+    size_t len;
+    if (std::is_signed<T>::value) {
+        len = formatSigned(buf, static_cast<int64_t>(value));
+    } else {
+        len = formatUnsigned(buf, static_cast<uint64_t>(value));
+    }
+    buf[len] = '\0';
+    return len;
+}
 
-    do {
-        int lsd = static_cast<int>(i % 10);
-        i /= 10;
-        *p++ = zero[lsd];
-    } while (i != 0);
+// 指针转十六进制：按大端取出各字节交给 hexEncode，再去掉前导 0
+size_t convertHex(char buf[], uintptr_t value)
+{
+    unsigned char bytes[sizeof value];
+    for (size_t i = 0; i < sizeof value; ++i) {
+        bytes[i] = static_cast<unsigned char>(value >> (8 * (sizeof value - 1 - i)));
+    }
+    char hex[2 * sizeof value];
+    detail::hexEncode(hex, bytes, sizeof value, true);
 
-    if (value < 0) {
-        *p++ = '-';
+    size_t skip = 0;
+    while (skip + 1 < sizeof hex && hex[skip] == '0') {
+        ++skip;
     }
-    *p = '\0';
-    std::reverse(buf, p);
+    size_t len = sizeof hex - skip;
+    memcpy(buf, hex + skip, len);
+    buf[len] = '\0';
 
-    return p - buf;
+    return len;
 }
 
-size_t convertHex(char buf[], uintptr_t value)
+size_t formatPointer(char* buf, const void* p)
+{
+    buf[0] = '0';
+    buf[1] = 'x';
+    return convertHex(buf + 2, reinterpret_cast<uintptr_t>(p)) + 2;
+}
+
+size_t formatDouble(char* buf, double v)
+{
+    return static_cast<size_t>(snprintf(buf, kMaxNumericSize, "%.12g", v));
+}
+
+namespace {
+
+// 每个线程缓存的空闲溢出块上限，超出的直接释放
+constexpr int kMaxPooledSpillBlocks = 16;
+
+class SpillPool {
+public:
+    SpillPool(): free_(nullptr), count_(0) {}
+    ~SpillPool()
+    {
+        while (free_) {
+            SpillBlock* next = free_->next_;
+            delete free_;
+            free_ = next;
+        }
+    }
+
+    SpillBlock* alloc()
+    {
+        SpillBlock* b = free_;
+        if (b) {
+            free_ = b->next_;
+            --count_;
+        } else {
+            b = new SpillBlock;
+        }
+        b->next_ = nullptr;
+        b->len_ = 0;
+        return b;
+    }
+
+    void release(SpillBlock* head)
+    {
+        while (head) {
+            SpillBlock* next = head->next_;
+            if (count_ < kMaxPooledSpillBlocks) {
+                head->next_ = free_;
+                free_ = head;
+                ++count_;
+            } else {
+                delete head;
+            }
+            head = next;
+        }
+    }
+
+private:
+    SpillBlock* free_;
+    int count_;
+};
+
+thread_local SpillPool t_spillPool;
+
+} // namespace
+
+SpillBlock* allocSpillBlock()
 {
-    uintptr_t i = value;
-    char* p = buf;
+    return t_spillPool.alloc();
+}
+
+void releaseSpillBlocks(SpillBlock* head)
+{
+    t_spillPool.release(head);
+}
 
-    do {
-        int lsd = static_cast<int>(i % 16);
-        i /= 16;
-        *p++ = digitsHex[lsd];
-    } while (i != 0);
+template <int SIZE>
+size_t FixedBuffer<SIZE>::totalLength() const
+{
+    size_t len = length();
+    for (const SpillBlock* b = spillHead_; b; b = b->next_) {
+        len += b->len_;
+    }
+    return len;
+}
 
-    *p = '\0';
-    std::reverse(buf, p);
+template <int SIZE>
+void FixedBuffer<SIZE>::appendSlow(const char* buf, size_t len)
+{
+    // 先填满内联缓冲，保证溢出后的内容严格接在其后
+    size_t n = avail();
+    memcpy(cur_, buf, n);
+    cur_ += n;
+    buf += n;
+    len -= n;
 
-    return p - buf;
+    while (len > 0) {
+        if (!spillTail_ || spillTail_->len_ == SpillBlock::kSize) {
+            if (spillCount_ >= kMaxSpillBlocks) {
+                return; // 超过单条记录上限，截断
+            }
+            SpillBlock* b = allocSpillBlock();
+            if (spillTail_) {
+                spillTail_->next_ = b;
+            } else {
+                spillHead_ = b;
+            }
+            spillTail_ = b;
+            ++spillCount_;
+        }
+        size_t room = SpillBlock::kSize - spillTail_->len_;
+        size_t m = len < room ? len : room;
+        memcpy(spillTail_->data_ + spillTail_->len_, buf, m);
+        spillTail_->len_ += static_cast<int>(m);
+        buf += m;
+        len -= m;
+    }
 }
 
 template class FixedBuffer<kSmallBuffer>;
 
+// 返回 s 中第一个需要转义的字节下标，没有则返回 len。
+// 需要转义的字节：<= ctrlMax 的控制字符，以及 c1、c2、c3。
+size_t scanEscapeScalar(const char* s, size_t len, unsigned char ctrlMax, char c1, char c2, char c3)
+{
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c <= ctrlMax || s[i] == c1 || s[i] == c2 || s[i] == c3) {
+            return i;
+        }
+    }
+    return len;
+}
+
+#if defined(__SSE2__)
+// 每次比较 16 字节，movemask 后取最低位即第一个命中的位置
+size_t scanEscapeSse2(const char* s, size_t len, unsigned char ctrlMax, char c1, char c2, char c3)
+{
+    const __m128i vctrl = _mm_set1_epi8(static_cast<char>(ctrlMax));
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i v3 = _mm_set1_epi8(c3);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        // 无符号 b <= ctrlMax 等价于 max(b, ctrlMax) == ctrlMax
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(b, vctrl), vctrl);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(b, v1));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(b, v2));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(b, v3));
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scanEscapeScalar(s + i, len - i, ctrlMax, c1, c2, c3);
+}
+
+__attribute__((target("avx2")))
+size_t scanEscapeAvx2(const char* s, size_t len, unsigned char ctrlMax, char c1, char c2, char c3)
+{
+    const __m256i vctrl = _mm256_set1_epi8(static_cast<char>(ctrlMax));
+    const __m256i v1 = _mm256_set1_epi8(c1);
+    const __m256i v2 = _mm256_set1_epi8(c2);
+    const __m256i v3 = _mm256_set1_epi8(c3);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i m = _mm256_cmpeq_epi8(_mm256_max_epu8(b, vctrl), vctrl);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(b, v1));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(b, v2));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(b, v3));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(m));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + scanEscapeSse2(s + i, len - i, ctrlMax, c1, c2, c3);
+}
+#endif
+
+typedef size_t (*ScanEscapeFunc)(const char*, size_t, unsigned char, char, char, char);
+
+// 运行时按 CPU 支持的指令集选择实现
+ScanEscapeFunc resolveScanEscape()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return scanEscapeAvx2;
+    }
+    return scanEscapeSse2;
+#else
+    return scanEscapeScalar;
+#endif
+}
+
+size_t scanEscape(const char* s, size_t len, unsigned char ctrlMax, char c1, char c2, char c3)
+{
+    static const ScanEscapeFunc func = resolveScanEscape();
+    return func(s, len, ctrlMax, c1, c2, c3);
+}
+
 } // namespace detail
 
+LogStream::KvFormat LogStream::kvFormat_ = LogStream::kLogfmt;
+
 
 template <typename T>
 void LogStream::formatInteger(T v)
@@ -71,6 +271,10 @@ void LogStream::formatInteger(T v)
     if (buffer_.avail() >= kMaxNumericSize) {
         size_t len = convert(buffer_.current(), v);
         buffer_.add(len);
+    } else {
+        // 内联缓冲将满，经由 append 写入溢出块
+        char tmp[kMaxNumericSize];
+        buffer_.append(tmp, convert(tmp, v));
     }
 }
 
@@ -124,13 +328,79 @@ LogStream& LogStream::operator<<(unsigned long long v)
 
 LogStream& LogStream::operator<<(const void* p)
 {
-    uintptr_t v = reinterpret_cast<uintptr_t>(p);
     if (buffer_.avail() >= kMaxNumericSize) {
-        char* buf = buffer_.current();
-        buf[0] = '0';
-        buf[1] = 'x';
-        size_t len = convertHex(buf + 2, v);
-        buffer_.add(len + 2);
+        buffer_.add(formatPointer(buffer_.current(), p));
+    } else {
+        char tmp[kMaxNumericSize];
+        buffer_.append(tmp, formatPointer(tmp, p));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const Hex& v)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(v.data_);
+    size_t n = v.len_;
+    while (n > 0) {
+        // 当前块放得下就直接编码进缓冲区，否则经小块临时区走 append 的溢出路径
+        size_t room = static_cast<size_t>(buffer_.avail()) / 2;
+        if (room >= 32) {
+            size_t chunk = std::min(n, room);
+            detail::hexEncode(buffer_.current(), p, chunk, v.upper_);
+            buffer_.add(2 * chunk);
+            p += chunk;
+            n -= chunk;
+        } else {
+            char tmp[64];
+            size_t chunk = std::min<size_t>(n, 32);
+            detail::hexEncode(tmp, p, chunk, v.upper_);
+            buffer_.append(tmp, 2 * chunk);
+            p += chunk;
+            n -= chunk;
+        }
+    }
+    return *this;
+}
+
+// 每行: "00000010  48 65 6c 6c 6f 20 77 6f  72 6c 64 0a 00 01 02 03  |Hello world.....|"
+LogStream& LogStream::operator<<(const HexDump& v)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(v.data_);
+    for (size_t off = 0; off < v.len_; off += 16) {
+        size_t n = std::min<size_t>(16, v.len_ - off);
+        char hex[32];
+        detail::hexEncode(hex, p + off, n, false);
+
+        char line[80];
+        unsigned char offBytes[4] = { static_cast<unsigned char>(off >> 24),
+            static_cast<unsigned char>(off >> 16), static_cast<unsigned char>(off >> 8),
+            static_cast<unsigned char>(off) };
+        line[0] = '\n';
+        detail::hexEncode(line + 1, offBytes, 4, false);
+        char* q = line + 9;
+        *q++ = ' ';
+        for (size_t i = 0; i < 16; ++i) {
+            if (i == 8) {
+                *q++ = ' ';
+            }
+            *q++ = ' ';
+            if (i < n) {
+                *q++ = hex[2 * i];
+                *q++ = hex[2 * i + 1];
+            } else {
+                *q++ = ' ';
+                *q++ = ' ';
+            }
+        }
+        *q++ = ' ';
+        *q++ = ' ';
+        *q++ = '|';
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char c = p[off + i];
+            *q++ = (c >= 0x20 && c < 0x7F) ? static_cast<char>(c) : '.';
+        }
+        *q++ = '|';
+        buffer_.append(line, q - line);
     }
     return *this;
 }
@@ -138,12 +408,92 @@ LogStream& LogStream::operator<<(const void* p)
 LogStream& LogStream::operator<<(double v)
 {
     if (buffer_.avail() >= kMaxNumericSize) {
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
-        buffer_.add(len);
+        buffer_.add(formatDouble(buffer_.current(), v));
+    } else {
+        char tmp[kMaxNumericSize];
+        buffer_.append(tmp, formatDouble(tmp, v));
     }
     return *this;
 }
 
+void LogStream::appendKvKey(const char* key)
+{
+    if (kvFormat_ == kJson) {
+        if (kvCount_ == 0) {
+            buffer_.append(" {\"", 3);
+        } else {
+            buffer_.append(",\"", 2);
+        }
+        appendEscaped(key, strlen(key));
+        buffer_.append("\":", 2);
+    } else {
+        // 含空格、'='、引号等的键与值一样加引号转义，否则 logfmt 解析器无法切分
+        buffer_.append(" ", 1);
+        appendKvString(key, strlen(key));
+        buffer_.append("=", 1);
+    }
+    ++kvCount_;
+}
+
+void LogStream::appendKvString(const char* str, size_t len)
+{
+    if (kvFormat_ == kLogfmt) {
+        // logfmt 的值不含空格、'='、引号、反斜杠和控制字符时可以不加引号
+        size_t n = scanEscape(str, len, 0x20, '"', '\\', '=');
+        if (n == len && len > 0) {
+            buffer_.append(str, len);
+            return;
+        }
+        buffer_.append("\"", 1);
+        // 前 n 个字节已确认不需要转义
+        buffer_.append(str, n);
+        appendEscaped(str + n, len - n);
+        buffer_.append("\"", 1);
+        return;
+    }
+    buffer_.append("\"", 1);
+    appendEscaped(str, len);
+    buffer_.append("\"", 1);
+}
+
+// 引号内的转义规则 logfmt 与 JSON 相同：引号、反斜杠和控制字符
+void LogStream::appendEscaped(const char* str, size_t len)
+{
+    while (len > 0) {
+        size_t n = scanEscape(str, len, 0x1F, '"', '\\', '"');
+        buffer_.append(str, n);
+        if (n == len) {
+            break;
+        }
+        char c = str[n];
+        switch (c) {
+        case '"':
+            buffer_.append("\\\"", 2);
+            break;
+        case '\\':
+            buffer_.append("\\\\", 2);
+            break;
+        case '\n':
+            buffer_.append("\\n", 2);
+            break;
+        case '\r':
+            buffer_.append("\\r", 2);
+            break;
+        case '\t':
+            buffer_.append("\\t", 2);
+            break;
+        default: {
+            char esc[6] = { '\\', 'u', '0', '0',
+                digitsHex[(c >> 4) & 0xF], digitsHex[c & 0xF] };
+            buffer_.append(esc, 6);
+            break;
+        }
+        }
+        str += n + 1;
+        len -= n + 1;
+    }
+}
+
 // 选取 kMaxNumericSize 值时用
 void LogStream::staticCheck()
 {
@@ -3,10 +3,16 @@
 #define WNLOGSTREAM_H
 
 #include <cassert>
+#include <cmath>
 #include <cstring> // memcpy
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 
+// 多个模块各自定义了 noncopyable，同时包含时只保留一份
+#ifndef WN_NONCOPYABLE_DEFINED
+#define WN_NONCOPYABLE_DEFINED
 class noncopyable {
 public:
     noncopyable(const noncopyable&) = delete;
@@ -16,6 +22,7 @@ protected:
     noncopyable() = default;
     ~noncopyable() = default;
 };
+#endif
 
 template <typename To, typename From>
 inline To implicit_cast(From const& f)
@@ -27,56 +34,143 @@ namespace detail {
     constexpr int kSmallBuffer = 4000;
     constexpr int kLargeBuffer = 4000 * 1000;
 
+    // 溢出块：一条记录超出内联缓冲时链在 FixedBuffer 后面，输出时按 writev 方式分段写出
+    struct SpillBlock {
+        static constexpr int kSize = 16 * 1024 - 16;
+
+        SpillBlock* next_;
+        int len_;
+        char data_[kSize];
+    };
+    // 单条记录最多溢出 kLargeBuffer 字节，再多才截断
+    constexpr int kMaxSpillBlocks = kLargeBuffer / SpillBlock::kSize;
+
+    // 单个数值格式化后的最大长度(含 '\0')。
+    // 以下格式化函数供 LogStream 与 StringBuilder(wnstring/wnstringlog.h) 共用，两者输出逐字节一致；
+    // 整数见 wndigits.h。buf 至少 kMaxNumericSize 字节，返回长度(不含 '\0')
+    constexpr int kMaxNumericSize = 32;
+    // "%.12g"
+    size_t formatDouble(char* buf, double v);
+    // "0x" 加大写十六进制，不补前导 0
+    size_t formatPointer(char* buf, const void* p);
+
+    // 溢出块来自线程局部的空闲链表，稳态下不再分配
+    SpillBlock* allocSpillBlock();
+    void releaseSpillBlocks(SpillBlock* head);
+
     template <int SIZE>
     class FixedBuffer : noncopyable {
     public:
-        FixedBuffer(): cur_(data_)
+        FixedBuffer(): cur_(data_), spillHead_(nullptr), spillTail_(nullptr), spillCount_(0)
         {
         }
+        ~FixedBuffer()
+        {
+            if (spillHead_) {
+                releaseSpillBlocks(spillHead_);
+            }
+        }
 
         void append(const char* buf, size_t len)
         {
-            // FIXME: append partially
             if (implicit_cast<size_t>(avail()) > len) {
                 memcpy(cur_, buf, len);
                 cur_ += len;
-            }else{
-                int ava = avail();
-                memcpy(cur_, buf, ava);
-                cur_ += ava;
+            } else {
+                appendSlow(buf, len);
             }
         }
 
         const char* data() const { return data_; }
+        // 内联缓冲中的长度
         int length() const { return static_cast<int>(cur_ - data_); }
+        // 含溢出块的总长度
+        size_t totalLength() const;
+        bool spilled() const { return spillHead_ != nullptr; }
+        int spillCount() const { return spillCount_; }
+
+        // 依次以 (data, len) 回调内联缓冲和每个溢出块
+        template <typename Func>
+        void forEachChunk(Func func) const
+        {
+            func(data_, length());
+            for (const SpillBlock* b = spillHead_; b; b = b->next_) {
+                func(b->data_, b->len_);
+            }
+        }
 
         // write to data_ directly
+        // 溢出后 avail() 恒为 0，数值格式化会改走临时缓冲 + append
         char* current() { return cur_; }
         int avail() const { return static_cast<int>(end() - cur_); }
         void add(size_t len) { cur_ += len; }
 
-        void reset() { cur_ = data_; } //惰性删除，同redis
+        void reset() //惰性删除，同redis
+        {
+            cur_ = data_;
+            if (spillHead_) {
+                releaseSpillBlocks(spillHead_);
+                spillHead_ = spillTail_ = nullptr;
+                spillCount_ = 0;
+            }
+        }
         void bzero() { memset(data_, 0, sizeof data_); }
 
         // for used by unit test
-        std::string toString() const { return std::string(data_, length()); }
+        std::string toString() const
+        {
+            std::string str;
+            str.reserve(totalLength());
+            forEachChunk([&str](const char* p, int n) { str.append(p, n); });
+            return str;
+        }
 
     private:
         const char* end() const { return data_ + sizeof data_; }
-
+        // 填满内联缓冲后，剩余部分写入溢出块
+        void appendSlow(const char* buf, size_t len);
 
         char data_[SIZE];
         char* cur_;
+        SpillBlock* spillHead_;
+        SpillBlock* spillTail_;
+        int spillCount_;
     };
 
 } // namespace detail
 
+// 二进制数据按十六进制输出，直接编码进日志缓冲区，不经过临时 std::string。
+// 用法: LOG_INFO << "digest=" << Hex(md, 16);
+struct Hex {
+    Hex(const void* data, size_t len, bool upper = false): data_(data), len_(len), upper_(upper) {}
+    const void* data_;
+    size_t len_;
+    bool upper_;
+};
+
+// 类似 hexdump -C 的多行格式(偏移 + 16 字节十六进制 + 可打印字符)，适合打印协议帧
+struct HexDump {
+    HexDump(const void* data, size_t len): data_(data), len_(len) {}
+    const void* data_;
+    size_t len_;
+};
+
 class LogStream : noncopyable {
     typedef LogStream self;
 
 public:
     typedef detail::FixedBuffer<detail::kSmallBuffer> Buffer;
 
+    // 结构化日志的输出格式：
+    // kLogfmt: msg key=value key2="带 空格"
+    // kJson:   msg {"key":value,"key2":"..."}
+    enum KvFormat {
+        kLogfmt,
+        kJson,
+    };
+
+    LogStream(): kvCount_(0) {}
+
     self& operator<<(bool v)
     {
         buffer_.append(v ? "1" : "0", 1);
@@ -131,9 +225,75 @@ public:
         return *this;
     }
 
+    // 已知长度的字符串片段，省去 strlen，也不必为拼接构造临时 std::string
+    self& operator<<(std::string_view v)
+    {
+        buffer_.append(v.data(), v.size());
+        return *this;
+    }
+
+    self& operator<<(const Hex& v);
+    self& operator<<(const HexDump& v);
+
+    // 结构化键值对，直接写入 buffer_，不产生临时字符串。键与字符串值按同样的规则转义。
+    // 用法: LOG_INFO.kv("user", id).kv("latency_us", t);
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value, self&>::type
+    kv(const char* key, T v)
+    {
+        appendKvKey(key);
+        // JSON 不能表示 nan/inf
+        if (kvFormat_ == kJson && std::is_floating_point<T>::value
+            && !std::isfinite(static_cast<double>(v))) {
+            buffer_.append("null", 4);
+        } else {
+            *this << v;
+        }
+        return *this;
+    }
+    self& kv(const char* key, bool v)
+    {
+        appendKvKey(key);
+        if (kvFormat_ == kJson) {
+            buffer_.append(v ? "true" : "false", v ? 4 : 5);
+        } else {
+            *this << v;
+        }
+        return *this;
+    }
+    self& kv(const char* key, char v) { return kv(key, &v, 1); }
+    self& kv(const char* key, const char* v)
+    {
+        return v ? kv(key, v, strlen(v)) : kv(key, "(null)", 6);
+    }
+    self& kv(const char* key, const std::string& v) { return kv(key, v.data(), v.size()); }
+    self& kv(const char* key, std::string_view v) { return kv(key, v.data(), v.size()); }
+    self& kv(const char* key, const char* v, size_t len)
+    {
+        appendKvKey(key);
+        appendKvString(v, len);
+        return *this;
+    }
+
+    // Logger 在一条记录结束时调用，补上 JSON 的右括号
+    void finishKv()
+    {
+        if (kvCount_ > 0 && kvFormat_ == kJson) {
+            buffer_.append("}", 1);
+        }
+        kvCount_ = 0;
+    }
+
+    // 进程级设置，应在启动时调用
+    static void setKvFormat(KvFormat fmt) { kvFormat_ = fmt; }
+
     void append(const char* data, int len) { buffer_.append(data, len); }
     const Buffer& buffer() const { return buffer_; }
-    void resetBuffer() { buffer_.reset(); }
+    void resetBuffer()
+    {
+        buffer_.reset();
+        kvCount_ = 0;
+    }
 
 private:
     void staticCheck();
@@ -141,9 +301,14 @@ private:
     template <typename T>
     void formatInteger(T);
 
+    void appendKvKey(const char* key);
+    void appendKvString(const char* str, size_t len);
+    void appendEscaped(const char* str, size_t len);
+
     Buffer buffer_;
+    int kvCount_; // 本条记录已写入的键值对数
 
-    static const int kMaxNumericSize = 32;
+    static KvFormat kvFormat_;
 };
 
 #endif // LOGSTREAM_H
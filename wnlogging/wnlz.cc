@@ -0,0 +1,172 @@
+#include "wnlz.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int kMinMatch = 4;
+constexpr int kHashLog = 12;
+constexpr size_t kMaxOffset = 65535;
+// 与 LZ4 相同：最后 5 个字节总是字面量，最后一个匹配至少在结尾前 12 字节开始
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMfLimit = 12;
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - kHashLog);
+}
+
+inline uint8_t* writeLength(uint8_t* op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+uint8_t* emitSequence(uint8_t* op, const uint8_t* literals, size_t litLen, size_t offset, size_t matchLen)
+{
+    uint8_t* token = op++;
+    size_t ml = matchLen - kMinMatch;
+    *token = static_cast<uint8_t>(((litLen < 15 ? litLen : 15) << 4) | (ml < 15 ? ml : 15));
+    if (litLen >= 15) {
+        op = writeLength(op, litLen - 15);
+    }
+    memcpy(op, literals, litLen);
+    op += litLen;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    if (ml >= 15) {
+        op = writeLength(op, ml - 15);
+    }
+    return op;
+}
+
+// 读取扩展长度，输入耗尽或溢出时返回 false
+inline bool readLength(const uint8_t*& ip, const uint8_t* iend, size_t* len)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+size_t lzCompress(const char* src, size_t n, char* dst)
+{
+    const uint8_t* const base = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* const iend = base + n;
+    const uint8_t* ip = base;
+    const uint8_t* anchor = base;
+    uint8_t* op = reinterpret_cast<uint8_t*>(dst);
+
+    if (n >= kMfLimit + 1) {
+        uint32_t table[1 << kHashLog] = {};
+        const uint8_t* const mflimit = iend - kMfLimit;
+        const uint8_t* const matchLimit = iend - kLastLiterals;
+        while (ip < mflimit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash4(seq);
+            const uint8_t* ref = base + table[h];
+            table[h] = static_cast<uint32_t>(ip - base);
+            if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset || read32(ref) != seq) {
+                // 连续不命中时逐渐加大步长，不可压缩的数据也能很快跳过
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            // 向前扩展
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+            // 向后扩展
+            const uint8_t* mp = ip + kMinMatch;
+            const uint8_t* mr = ref + kMinMatch;
+            while (mp < matchLimit && *mp == *mr) {
+                ++mp;
+                ++mr;
+            }
+            op = emitSequence(op, anchor, ip - anchor, ip - ref, mp - ip);
+            ip = mp;
+            anchor = ip;
+        }
+    }
+
+    // 剩余部分作为最后一个只有字面量的序列
+    size_t litLen = iend - anchor;
+    *op++ = static_cast<uint8_t>((litLen < 15 ? litLen : 15) << 4);
+    if (litLen >= 15) {
+        op = writeLength(op, litLen - 15);
+    }
+    memcpy(op, anchor, litLen);
+    op += litLen;
+    return op - reinterpret_cast<uint8_t*>(dst);
+}
+
+bool lzDecompress(const char* src, size_t n, char* dst, size_t rawLen)
+{
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* const iend = ip + n;
+    uint8_t* const obase = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* op = obase;
+    uint8_t* const oend = obase + rawLen;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !readLength(ip, iend, &litLen)) {
+            return false;
+        }
+        if (litLen > static_cast<size_t>(iend - ip) || litLen > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == iend) {
+            break; // 最后一个序列
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !readLength(ip, iend, &matchLen)) {
+            return false;
+        }
+        matchLen += kMinMatch;
+        if (offset == 0 || offset > static_cast<size_t>(op - obase)
+            || matchLen > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        // 匹配可能与输出重叠(offset < matchLen)，只能逐字节复制
+        const uint8_t* ref = op - offset;
+        if (offset >= matchLen) {
+            memcpy(op, ref, matchLen);
+            op += matchLen;
+        } else {
+            for (size_t i = 0; i < matchLen; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == oend;
+}
@@ -0,0 +1,25 @@
+#ifndef WNLZ_H
+#define WNLZ_H
+
+#include <cstddef>
+
+// 简单的 LZ77 块压缩(格式类似 LZ4)，用于日志的后台压缩。
+// 日志文本重复度高，单线程即可达到数百 MB/s 的压缩速度。
+//
+// 每个序列: token(高4位字面量长度, 低4位匹配长度-4)
+//          [字面量长度扩展] 字面量 偏移(2字节,小端) [匹配长度扩展]
+// 最后一个序列只有字面量。长度 >= 15 时后续每个 255 字节累加，直到遇到小于 255 的字节。
+
+// 压缩 n 字节最坏情况下需要的输出空间
+inline size_t lzCompressBound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+// 返回压缩后的长度，dst 至少需要 lzCompressBound(n) 字节
+size_t lzCompress(const char* src, size_t n, char* dst);
+
+// 解压出恰好 rawLen 字节时返回 true；输入损坏时返回 false，不会越界读写
+bool lzDecompress(const char* src, size_t n, char* dst, size_t rawLen);
+
+#endif // WNLZ_H
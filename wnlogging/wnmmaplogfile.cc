@@ -0,0 +1,230 @@
+#include "wnmmaplogfile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+size_t pageSize()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+size_t roundUpToPage(size_t n)
+{
+    size_t page = pageSize();
+    return (n + page - 1) / page * page;
+}
+
+} // namespace
+
+MmapLogFile::MmapLogFile(const std::string& filename, size_t windowSize,
+    SyncPolicy policy, bool dropBehind, bool threadSafe)
+    : mutex_(threadSafe ? new std::mutex : nullptr)
+    , windowSize_(roundUpToPage(windowSize ? windowSize : 1))
+    , policy_(policy)
+    , dropBehind_(dropBehind)
+    , fd_(-1)
+    , base_(nullptr)
+    , windowOffset_(0)
+    , pos_(0)
+    , syncedPos_(0)
+    , fileLen_(0)
+{
+    open(filename);
+}
+
+MmapLogFile::~MmapLogFile()
+{
+    close();
+}
+
+void MmapLogFile::append(const char* data, size_t len)
+{
+    if (mutex_) {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        append_unlocked(data, len);
+    } else {
+        append_unlocked(data, len);
+    }
+}
+
+void MmapLogFile::append_unlocked(const char* data, size_t len)
+{
+    while (len > 0 && base_) {
+        size_t n = windowSize_ - pos_;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(base_ + pos_, data, n);
+        pos_ += n;
+        fileLen_ += n;
+        data += n;
+        len -= n;
+        if (pos_ == windowSize_) {
+            // 窗口写满，滑动到下一个窗口
+            off_t next = windowOffset_ + static_cast<off_t>(windowSize_);
+            unmapWindow(true);
+            mapWindow(next);
+        }
+    }
+    // 预分配或映射失败后退化为 pwrite，不丢弃剩下的数据
+    while (len > 0 && fd_ >= 0) {
+        ssize_t n = ::pwrite(fd_, data, len, fileLen_);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "MmapLogFile: write failed, %zu bytes dropped: %s\n", len, strerror(errno));
+            return;
+        }
+        fileLen_ += n;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void MmapLogFile::flush()
+{
+    if (policy_ != kSyncOnFlush) {
+        // 数据已在页缓存中，交给内核异步回写，不需要任何系统调用
+        return;
+    }
+    std::unique_lock<std::mutex> lock;
+    if (mutex_) {
+        lock = std::unique_lock<std::mutex>(*mutex_);
+    }
+    if (base_ && pos_ > syncedPos_) {
+        // msync 的起始地址必须页对齐
+        size_t begin = syncedPos_ / pageSize() * pageSize();
+        msync(base_ + begin, pos_ - begin, MS_SYNC);
+        syncedPos_ = pos_;
+    } else if (!base_ && fd_ >= 0) {
+        fdatasync(fd_);
+    }
+}
+
+bool MmapLogFile::rotate(const std::string& newFilename)
+{
+    std::unique_lock<std::mutex> lock;
+    if (mutex_) {
+        lock = std::unique_lock<std::mutex>(*mutex_);
+    }
+    close();
+    return open(newFilename);
+}
+
+bool MmapLogFile::open(const std::string& filename)
+{
+    fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        fprintf(stderr, "MmapLogFile: open %s failed: %s\n", filename.c_str(), strerror(errno));
+        return false;
+    }
+    // 已存在的文件接着末尾追加
+    struct stat st;
+    fileLen_ = (fstat(fd_, &st) == 0) ? st.st_size : 0;
+    // 上次没有正常关闭时，预分配的窗口末尾是 NUL 填充，去掉后再接着写
+    fileLen_ = trimmedLength(fileLen_);
+    off_t page = static_cast<off_t>(pageSize());
+    return mapWindow(fileLen_ / page * page);
+}
+
+// 从 len 往前跳过末尾的 NUL 字节，返回最后一个非 NUL 字节之后的位置
+off_t MmapLogFile::trimmedLength(off_t len) const
+{
+    char buf[4096];
+    while (len > 0) {
+        off_t begin = len > static_cast<off_t>(sizeof buf) ? len - static_cast<off_t>(sizeof buf) : 0;
+        ssize_t n = ::pread(fd_, buf, static_cast<size_t>(len - begin), begin);
+        if (n != len - begin) {
+            // 读不出来时保留原长度，宁可多留填充也不截掉数据
+            return len;
+        }
+        while (n > 0 && buf[n - 1] == '\0') {
+            --n;
+        }
+        if (n > 0) {
+            return begin + n;
+        }
+        len = begin;
+    }
+    return 0;
+}
+
+void MmapLogFile::close()
+{
+    if (fd_ < 0) {
+        return;
+    }
+    if (base_) {
+        if (policy_ == kSyncOnFlush && pos_ > syncedPos_) {
+            msync(base_, pos_, MS_SYNC);
+        }
+        unmapWindow(false);
+    }
+    // 去掉预分配但没写到的部分
+    if (ftruncate(fd_, fileLen_) != 0) {
+        fprintf(stderr, "MmapLogFile: ftruncate failed: %s\n", strerror(errno));
+    }
+    ::close(fd_);
+    fd_ = -1;
+    fileLen_ = 0;
+}
+
+bool MmapLogFile::mapWindow(off_t offset)
+{
+    // 预分配磁盘块，避免写入缺页时才分配导致 SIGBUS；文件系统不支持时退化为 ftruncate
+    int ret = fallocate(fd_, 0, offset, static_cast<off_t>(windowSize_));
+    if (ret != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+        struct stat st;
+        off_t end = offset + static_cast<off_t>(windowSize_);
+        ret = (fstat(fd_, &st) == 0 && st.st_size >= end) ? 0 : ftruncate(fd_, end);
+    }
+    if (ret != 0) {
+        fprintf(stderr, "MmapLogFile: preallocate failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    void* p = mmap(nullptr, windowSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "MmapLogFile: mmap failed: %s\n", strerror(errno));
+        return false;
+    }
+    madvise(p, windowSize_, MADV_SEQUENTIAL);
+    base_ = static_cast<char*>(p);
+    windowOffset_ = offset;
+    pos_ = static_cast<size_t>(fileLen_ - offset);
+    syncedPos_ = pos_;
+    return true;
+}
+
+// retire 为 true 表示窗口已写满被换出，按策略发起回写
+void MmapLogFile::unmapWindow(bool retire)
+{
+    if (retire) {
+        if (policy_ == kAsyncOnRetire) {
+            msync(base_, windowSize_, MS_ASYNC);
+        } else if (policy_ == kSyncOnFlush && pos_ > syncedPos_) {
+            msync(base_, windowSize_, MS_SYNC);
+        }
+    }
+    munmap(base_, windowSize_);
+    base_ = nullptr;
+
+    if (retire && dropBehind_) {
+        // 立即发起本窗口的回写；上一个窗口此时通常已回写完毕，可以从页缓存丢弃
+        sync_file_range(fd_, windowOffset_, static_cast<off_t>(windowSize_), SYNC_FILE_RANGE_WRITE);
+        if (windowOffset_ >= static_cast<off_t>(windowSize_)) {
+            posix_fadvise(fd_, windowOffset_ - static_cast<off_t>(windowSize_),
+                static_cast<off_t>(windowSize_), POSIX_FADV_DONTNEED);
+        }
+    }
+}
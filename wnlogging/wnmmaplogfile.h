@@ -0,0 +1,71 @@
+#ifndef WNMMAPLOGFILE_H
+#define WNMMAPLOGFILE_H
+
+#include "wnlogstream.h" // noncopyable
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <sys/types.h>
+
+// 基于 mmap 的日志文件，可替代 fwrite 作为 Logger 的输出。
+// 用 fallocate 预分配并映射固定大小的窗口，追加日志只是 memcpy，
+// 窗口写满后向后滑动，关闭或切换文件时 ftruncate 到实际长度。
+// 进程崩溃时来不及 ftruncate，文件末尾会留下预分配窗口的 NUL 填充；再次打开时先去掉末尾的 NUL，
+// 新日志紧接在最后一个非 NUL 字节之后(因此内容本身不能以 NUL 结尾)。
+// 预分配或 mmap 失败时(磁盘满、地址空间不足)退化为 pwrite 写入，此时 ok() 返回 false。
+//
+// 用法:
+//   MmapLogFile* g_logFile = new MmapLogFile("app.log");
+//   Logger::setOutput([](const char* msg, int len) { g_logFile->append(msg, len); });
+//   Logger::setFlush([]() { g_logFile->flush(); });
+class MmapLogFile : noncopyable {
+public:
+    // 持久性策略
+    enum SyncPolicy {
+        kNoSync, // 完全交给内核回写
+        kAsyncOnRetire, // 窗口写满换出时 msync(MS_ASYNC) 发起回写
+        kSyncOnFlush, // 每次 flush() 都 msync(MS_SYNC)，持久性最好，代价也最高
+    };
+
+    // windowSize 会向上取整到页大小。
+    // dropBehind 为 true 时，已换出窗口的页在回写后从页缓存中丢弃，减小页缓存压力
+    explicit MmapLogFile(const std::string& filename,
+        size_t windowSize = 64 * 1024 * 1024,
+        SyncPolicy policy = kAsyncOnRetire,
+        bool dropBehind = true,
+        bool threadSafe = true);
+    ~MmapLogFile();
+
+    // false 表示没有映射窗口，append 正在退化为 pwrite(或文件没能打开)
+    bool ok() const { return base_ != nullptr; }
+    void append(const char* data, size_t len);
+    void flush();
+    // 截断并关闭当前文件，之后写入 newFilename
+    bool rotate(const std::string& newFilename);
+    // 当前文件的实际长度
+    off_t writtenBytes() const { return fileLen_; }
+
+private:
+    bool open(const std::string& filename);
+    void close();
+    bool mapWindow(off_t offset);
+    void unmapWindow(bool retire);
+    off_t trimmedLength(off_t len) const;
+    void append_unlocked(const char* data, size_t len);
+
+    std::unique_ptr<std::mutex> mutex_;
+    const size_t windowSize_;
+    const SyncPolicy policy_;
+    const bool dropBehind_;
+
+    int fd_;
+    char* base_; // 当前窗口的映射地址
+    off_t windowOffset_; // 当前窗口在文件中的偏移，页对齐
+    size_t pos_; // 窗口内的写入位置
+    size_t syncedPos_; // kSyncOnFlush 下窗口内已 msync 的位置
+    off_t fileLen_; // 文件实际内容长度
+};
+
+#endif // WNMMAPLOGFILE_H
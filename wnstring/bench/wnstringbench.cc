@@ -0,0 +1,320 @@
+// wnstringbench: Wnstring 与 std::string 的微基准测试。
+// 按长度扫过 small(<= maxSmallSize)、medium(<= maxMediumSize)、large(COW) 三档的边界，
+// 测构造、拷贝、移动、查找、比较、追加、析构的单次开销，以及多线程同时拷贝/析构同一个 large string 时
+// 引用计数的争用。LocalWnstring(非原子引用计数)只参与单线程的测试。结果每行一个 JSON 对象，便于脚本比较。
+//
+// 编译(在本目录下):
+//   g++ -O2 -std=c++17 -o wnstringbench wnstringbench.cc ../wnstring.cc ../wnstringalloc.cc
+//       ../wnstringhash.cc ../wnstringsearch.cc ../wnstringutf8.cc -pthread
+// 用法:
+//   wnstringbench [-n 每项操作次数] [-t 最大线程数] [-c construct,copy,move,find,compare,append,destroy,shared]
+//                 [-z 8,23,24,255,256,4096] [-o 结果文件]
+// 结果默认写到标准错误。
+
+#include "../wnstring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    long ops = 1000000;
+    int maxThreads = 4;
+    std::vector<std::string> cases { "construct", "copy", "move", "find", "compare", "append", "destroy", "shared" };
+    // 每档的两端和中间各取几个点，看开销在阈值处的跳变
+    std::vector<size_t> sizes { 8, 16, maxSmallSize, maxSmallSize + 1, 64, 128, maxMediumSize, maxMediumSize + 1,
+        1024, 4096 };
+    FILE* out = stderr;
+};
+
+std::vector<std::string> split(const char* arg)
+{
+    std::vector<std::string> items;
+    std::string s(arg);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == std::string::npos) {
+            comma = s.size();
+        }
+        if (comma > start) {
+            items.push_back(s.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return items;
+}
+
+// 阻止编译器把结果未被使用的操作整个删掉
+template <typename T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+const char* sizeClass(size_t n)
+{
+    return n <= maxSmallSize ? "small" : (n <= maxMediumSize ? "medium" : "large");
+}
+
+double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 内容是 'a'~'z' 循环，末尾 3 个字节是 "XYZ"，供 find 从头扫到尾
+std::string makeText(size_t n)
+{
+    std::string s(n, 'a');
+    for (size_t i = 0; i < n; ++i) {
+        s[i] = static_cast<char>('a' + i % 26);
+    }
+    if (n >= 3) {
+        memcpy(&s[n - 3], "XYZ", 3);
+    }
+    return s;
+}
+
+// 以下每个函数返回 ops 次操作的总秒数。construct/copy 都包含对应的析构，单独的析构开销见 destroy
+
+template <typename S>
+double benchConstruct(const std::string& text, long ops)
+{
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        S s(text.data(), text.size());
+        keep(s);
+    }
+    return secondsSince(start);
+}
+
+template <typename S>
+double benchCopy(const std::string& text, long ops)
+{
+    const S source(text.data(), text.size());
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        S s(source);
+        keep(s);
+    }
+    return secondsSince(start);
+}
+
+// 一次操作是移出再移回的两次移动
+template <typename S>
+double benchMove(const std::string& text, long ops)
+{
+    S a(text.data(), text.size());
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        S b(std::move(a));
+        keep(b);
+        a = std::move(b);
+    }
+    keep(a);
+    return secondsSince(start);
+}
+
+template <typename S>
+double benchFind(const std::string& text, long ops)
+{
+    const S s(text.data(), text.size());
+    size_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        sum += s.find("XYZ", 0, 3);
+        keep(sum);
+    }
+    return secondsSince(start);
+}
+
+// 两个内容相同但各自独立分配的串，比较总要扫完全部字节
+template <typename S>
+double benchCompare(const std::string& text, long ops)
+{
+    const S a(text.data(), text.size());
+    const S b(text.data(), text.size());
+    int sum = 0;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        sum += a.compare(b);
+        keep(sum);
+    }
+    return secondsSince(start);
+}
+
+// 一次操作是从空串按 16 字节一段追加到目标长度，包含中途的扩容
+template <typename S>
+double benchAppend(const std::string& text, long ops)
+{
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < ops; ++i) {
+        S s;
+        for (size_t pos = 0; pos < text.size(); pos += 16) {
+            s.append(text.data() + pos, std::min<size_t>(16, text.size() - pos));
+        }
+        keep(s);
+    }
+    return secondsSince(start);
+}
+
+// 分批构造互不共享的串，只计析构的时间
+template <typename S>
+double benchDestroy(const std::string& text, long ops)
+{
+    const long batch = std::min(ops, 4096L);
+    std::vector<S> strings;
+    strings.reserve(batch);
+    double seconds = 0;
+    for (long done = 0; done < ops; done += batch) {
+        const long n = std::min(batch, ops - done);
+        for (long i = 0; i < n; ++i) {
+            strings.emplace_back(text.data(), text.size());
+        }
+        Clock::time_point start = Clock::now();
+        strings.clear();
+        seconds += secondsSince(start);
+    }
+    return seconds;
+}
+
+// 所有线程反复拷贝并析构同一个串。Wnstring 的 large string 每次只增减共享块上的原子引用计数，
+// 线程越多争用越重；std::string 每次深拷贝，不共享任何可写状态
+template <typename S>
+double benchShared(const std::string& text, long ops, int threads)
+{
+    const S shared(text.data(), text.size());
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&shared, ops] {
+            for (long i = 0; i < ops; ++i) {
+                S s(shared);
+                keep(s);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    return secondsSince(start);
+}
+
+template <typename S>
+double runCase(const std::string& name, const std::string& text, long ops)
+{
+    if (name == "construct") {
+        return benchConstruct<S>(text, ops);
+    } else if (name == "copy") {
+        return benchCopy<S>(text, ops);
+    } else if (name == "move") {
+        return benchMove<S>(text, ops);
+    } else if (name == "find") {
+        return benchFind<S>(text, ops);
+    } else if (name == "compare") {
+        return benchCompare<S>(text, ops);
+    } else if (name == "append") {
+        return benchAppend<S>(text, ops);
+    } else if (name == "destroy") {
+        return benchDestroy<S>(text, ops);
+    }
+    return -1;
+}
+
+// ops 是所有线程的总次数；ns_per_op 是单个线程平均每次操作的墙钟时间，多线程时的增长即争用的代价
+void report(const Options& opt, const std::string& name, const char* type, size_t size, int threads, double seconds)
+{
+    const long total = opt.ops * threads;
+    fprintf(opt.out,
+        "{\"case\":\"%s\",\"type\":\"%s\",\"size\":%zu,\"class\":\"%s\",\"threads\":%d,\"ops\":%ld,"
+        "\"seconds\":%.6f,\"ns_per_op\":%.2f}\n",
+        name.c_str(), type, size, sizeClass(size), threads, total, seconds, seconds * 1e9 / opt.ops);
+    fflush(opt.out);
+}
+
+std::vector<int> threadCounts(int maxThreads)
+{
+    std::vector<int> counts;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    const char* outPath = nullptr;
+    int c;
+    while ((c = getopt(argc, argv, "n:t:c:z:o:")) != -1) {
+        switch (c) {
+        case 'n':
+            opt.ops = std::max(1L, atol(optarg));
+            break;
+        case 't':
+            opt.maxThreads = std::max(1, atoi(optarg));
+            break;
+        case 'c':
+            opt.cases = split(optarg);
+            break;
+        case 'z':
+            opt.sizes.clear();
+            for (const std::string& s : split(optarg)) {
+                opt.sizes.push_back(strtoul(s.c_str(), nullptr, 10));
+            }
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n ops] [-t threads] [-c cases] [-z sizes] [-o out]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (outPath && !(opt.out = fopen(outPath, "w"))) {
+        perror(outPath);
+        return 1;
+    }
+
+    for (const std::string& name : opt.cases) {
+        for (size_t size : opt.sizes) {
+            const std::string text = makeText(size);
+            if (name == "shared") {
+                // 单线程时再比较一次非原子计数，看原子操作本身的代价
+                report(opt, name, "LocalWnstring", size, 1, benchShared<LocalWnstring>(text, opt.ops, 1));
+                for (int threads : threadCounts(opt.maxThreads)) {
+                    report(opt, name, "Wnstring", size, threads, benchShared<Wnstring>(text, opt.ops, threads));
+                    report(opt, name, "std::string", size, threads, benchShared<std::string>(text, opt.ops, threads));
+                }
+                continue;
+            }
+            const double wn = runCase<Wnstring>(name, text, opt.ops);
+            if (wn < 0) {
+                fprintf(stderr, "unknown case: %s\n", name.c_str());
+                return 2;
+            }
+            report(opt, name, "Wnstring", size, 1, wn);
+            report(opt, name, "LocalWnstring", size, 1, runCase<LocalWnstring>(name, text, opt.ops));
+            report(opt, name, "std::string", size, 1, runCase<std::string>(name, text, opt.ops));
+        }
+    }
+    if (opt.out != stderr) {
+        fclose(opt.out);
+    }
+    return 0;
+}
@@ -1,24 +1,732 @@
+#include <atomic>
+#include <cstdint>
 #include <errno.h>
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
-
+#include "wnrope.h"
 #include "wnstring.h"
+#include "wnstringintern.h"
+#include "wnstringlog.h"
+#include "wnstringmap.h"
 
 using namespace std;
 
+// 与 std::string 对照，逐步增长跨越 small -> medium -> large
+static bool testGrowth()
+{
+    Wnstring s;
+    std::string ref;
+    for (int i = 0; i < 1000; ++i) {
+        char c = static_cast<char>('a' + i % 26);
+        s.push_back(c);
+        ref.push_back(c);
+        if (i % 7 == 0) {
+            s.append("xyz", 3);
+            ref.append("xyz");
+        }
+        if (s.size() != ref.size() || strcmp(s.c_str(), ref.c_str()) != 0) {
+            cout << "growth mismatch at " << i << endl;
+            return false;
+        }
+    }
+    s.resize(10);
+    s.resize(30, '!');
+    ref.resize(10);
+    ref.resize(30, '!');
+    s.pop_back();
+    ref.pop_back();
+    // 追加自身(别名)
+    s.append(s);
+    ref.append(ref);
+    if (ref != s.c_str()) {
+        cout << "resize/self-append mismatch" << endl;
+        return false;
+    }
+    s.clear();
+    return s.empty() && s.c_str()[0] == '\0';
+}
 
+// 共享的 large string 修改前要先 unshare
+static bool testCow()
+{
+    std::string big(300, 'q');
+    Wnstring a(big.data(), big.size());
+    Wnstring b(a);
+    b.push_back('!');
+    Wnstring c(a);
+    c.pop_back();
+    return a.size() == 300 && b.size() == 301 && c.size() == 299 && a.c_str()[299] == 'q' && a.c_str()[300] == '\0';
+}
 
+// 移动后 vector 扩容只搬 24 字节的对象，字符串数据地址不变
+static bool testMove()
+{
+    std::vector<Wnstring> v;
+    std::vector<const char*> addrs;
+    std::string medium(100, 'm');
+    for (int i = 0; i < 100; ++i) {
+        v.push_back(Wnstring(medium.data(), medium.size()));
+        addrs.push_back(v.back().c_str());
+    }
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i].c_str() != addrs[i]) {
+            cout << "vector reallocation copied string bytes" << endl;
+            return false;
+        }
+    }
+    Wnstring moved(std::move(v[0]));
+    Wnstring assigned;
+    assigned = std::move(v[1]);
+    assigned = "short";
+    Wnstring copy;
+    copy = moved;
+    return v[0].empty() && moved.size() == 100 && copy.size() == 100 && strcmp(assigned.c_str(), "short") == 0
+        && strcmp((moved + assigned).c_str(), (medium + "short").c_str()) == 0;
+}
 
-int main(int argc, char const *argv[])
+// 随机文本上与 std::string 的结果对照，覆盖 memchr、SIMD 过滤和 Horspool 三条路径
+static bool testSearch()
 {
-    // const char* const test = "helloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworldhelloworld";
-    // cout << strlen(test) << endl;
-    // Wnstring testStr(forward<const char* const>(test),strlen(test));
-    // Wnstring testStr2(testStr);
-    // cout << testStr.size() << endl;
-    // cout << testStr[1];
+    srand(1);
+    for (int iter = 0; iter < 2000; ++iter) {
+        std::string hay;
+        size_t n = rand() % 600;
+        for (size_t i = 0; i < n; ++i) {
+            hay.push_back(static_cast<char>('a' + rand() % 3));
+        }
+        Wnstring s(hay.data(), hay.size());
+        size_t m = rand() % 48;
+        size_t start = n > 0 ? rand() % n : 0;
+        std::string needle = (rand() % 2 && start + m <= n) ? hay.substr(start, m) : std::string();
+        while (needle.size() < m) {
+            needle.push_back(static_cast<char>('a' + rand() % 3));
+        }
+        size_t pos = rand() % (n + 2);
+        size_t count = 0;
+        for (size_t p = 0; m > 0 && (p = hay.find(needle, p)) != std::string::npos; p += m) {
+            ++count;
+        }
+        std::string set = needle.substr(0, rand() % 10);
+        if (s.find(needle.c_str(), pos) != hay.find(needle, pos)
+            || s.rfind(needle.c_str(), pos) != hay.rfind(needle, pos)
+            || s.rfind(needle.c_str()) != hay.rfind(needle)
+            || s.find_first_of(set.c_str(), pos) != hay.find_first_of(set, pos)
+            || s.count(needle.c_str()) != count) {
+            cout << "search mismatch: n=" << n << " m=" << m << " pos=" << pos << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static int sign(int v) { return (v > 0) - (v < 0); }
 
+// 相等、字典序和哈希缓存
+static bool testCompare()
+{
+    const char* samples[] = { "", "a", "ab", "abc", "abd", "hello world, small", "hello world, small!",
+        "zzzzzzzzzzzzzzzzzzzzzzz" };
+    for (const char* x : samples) {
+        for (const char* y : samples) {
+            Wnstring a(x, strlen(x));
+            Wnstring b(y, strlen(y));
+            if ((a == b) != (strcmp(x, y) == 0) || sign(a.compare(b)) != sign(strcmp(x, y))
+                || (a < b) != (strcmp(x, y) < 0)) {
+                cout << "compare mismatch: " << x << " / " << y << endl;
+                return false;
+            }
+        }
+    }
+    std::string big(1000, 'h');
+    Wnstring l1(big.data(), big.size());
+    Wnstring l2(l1);
+    size_t h = l1.hash();
+    if (!(l1 == l2) || l2.hash() != h || l1.compare(l2) != 0) {
+        return false;
+    }
+    // 修改后哈希缓存失效，且与内容相同的新串哈希一致
+    l2[0] = 'x';
+    big[0] = 'x';
+    Wnstring l3(big.data(), big.size());
+    return l1 != l2 && l2 == l3 && l2.hash() == l3.hash() && l1.hash() == h && l1.hash() != l2.hash();
+}
+
+// substr 的视图不论源是 small、medium 还是 large 都持有引用，源追加(重新分配)或析构后仍然有效
+static bool testSubstrLifetime()
+{
+    for (size_t len : {10, 100, 300}) {
+        std::string text(len, 'x');
+        text.replace(0, 5, "hello");
+        WnstringView v;
+        {
+            Wnstring s(text.data(), text.size());
+            v = s.substr(0, 5);
+            for (int i = 0; i < 10; ++i) {
+                s.append(text.data(), text.size());
+            }
+        }
+        if (!v.shared() || v != "hello") {
+            cout << "substr dangles for length " << len << endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-    return 0;
+// large string 的切片共享 RefCounted，源析构后仍然有效
+static bool testView()
+{
+    std::string text;
+    for (int i = 0; i < 100; ++i) {
+        text += "field" + std::to_string(i) + ",";
+    }
+    text += ",tail";
+    WnstringView head;
+    std::vector<WnstringView> fields;
+    {
+        Wnstring big(text.data(), text.size());
+        head = big.substr(0, 6);
+        for (WnstringView f : split(big, ",")) {
+            fields.push_back(f);
+        }
+        if (!head.shared() || head.data() != big.c_str() || WnstringView(big).str().c_str() != big.c_str()) {
+            cout << "large substr copied" << endl;
+            return false;
+        }
+        big.push_back('!'); // 共享中修改会先 unshare，视图不受影响
+    }
+    if (head != "field0" || fields.size() != 102 || fields[99] != "field99" || !fields[100].empty()
+        || fields[101] != "tail") {
+        cout << "split mismatch" << endl;
+        return false;
+    }
+
+    std::vector<std::string> toks;
+    Wnstring line("  GET /index.html\tHTTP/1.1  ", 28);
+    for (WnstringView t : tokenize(line, " \t")) {
+        toks.emplace_back(t.data(), t.size());
+    }
+    return toks.size() == 3 && toks[0] == "GET" && toks[1] == "/index.html" && toks[2] == "HTTP/1.1"
+        && line.substr(2, 3).shared() && line.substr(2, 3) == "GET" && line.substr(2, 3).str() == Wnstring("GET", 3)
+        && testSubstrLifetime();
+}
+
+// 线程缓存复用刚释放的块；arena 作用域内的串来自 arena，作用域外的串不受影响
+static bool testAllocator()
+{
+    std::string medium(100, 'm');
+    const char* first;
+    {
+        Wnstring a(medium.data(), medium.size());
+        first = a.c_str();
+    }
+    Wnstring b(medium.data(), medium.size());
+    if (b.c_str() != first) {
+        cout << "thread cache did not reuse the block" << endl;
+        return false;
+    }
+
+    Wnstring outside(medium.data(), medium.size());
+    Wnrope rope;
+    WnstringArena arena;
+    {
+        WnstringArena::Scope scope(arena);
+        std::string text(300, 'r');
+        Wnstring scoped(text.data(), text.size());
+        rope.append(scoped); // arena 上的块复制到堆上，节点也在堆上
+        rope.append(text.data(), text.size());
+        {
+            WnstringArena::Suspend suspend;
+            Wnstring heap(medium.data(), medium.size());
+            if (heap.arena() || !scoped.arena()) {
+                cout << "suspend did not bypass the arena" << endl;
+                return false;
+            }
+        }
+        std::vector<Wnstring> parts;
+        for (int i = 0; i < 100; ++i) {
+            parts.emplace_back(medium.data(), medium.size());
+            parts.back().append(medium.c_str());
+        }
+        outside.append(medium.c_str()); // 堆上的串在作用域内增长仍留在堆上
+        std::string big(5000, 'b');
+        Wnstring large(big.data(), big.size());
+        Wnstring shared(large);
+        shared.push_back('!');
+        if (arena.bytesAllocated() == 0 || parts[99].size() != 200 || shared.size() != 5001) {
+            cout << "arena allocation failed" << endl;
+            return false;
+        }
+    }
+    arena.release();
+    return outside.size() == 200 && outside.c_str()[199] == 'm' && rope.size() == 600
+        && rope.flatten() == Wnstring(std::string(600, 'r').data(), 600);
+}
+
+// LocalWnstring 用普通整数计数；转换成 Wnstring 时唯一持有的块直接转交，共享的块复制
+static bool testLocal()
+{
+    std::string big(1000, 'l');
+    LocalWnstring a(big.data(), big.size());
+    LocalWnstring b(a);
+    b.append(",tail");
+    std::vector<LocalWnstringView> fields;
+    for (LocalWnstringView f : split(b, ",")) {
+        fields.push_back(f);
+    }
+    if (fields.size() != 2 || !fields[0].shared() || fields[0].size() != 1000 || fields[1] != "tail") {
+        cout << "local split mismatch" << endl;
+        return false;
+    }
+    LocalWnstring unique(a);
+    unique.push_back('!'); // unshare 后成为唯一持有者
+    const char* block = unique.c_str();
+    Wnstring handed(std::move(unique));
+    LocalWnstring keep(a);
+    Wnstring copied(std::move(a)); // 块还被 keep 共享，只能复制
+    LocalWnstring back(handed);
+    if (handed.c_str() != block || !unique.empty() || handed.size() != 1001 || copied.c_str() == keep.c_str()
+        || back != LocalWnstring(handed.c_str(), handed.size())) {
+        cout << "policy conversion mismatch" << endl;
+        return false;
+    }
+    LocalWnstring small("short", 5);
+    Wnstring smallMoved(std::move(small));
+    return smallMoved.size() == 5 && copied.size() == 1000;
+}
+
+// 随机拼接、截取与 std::string 对照；拷贝出去的绳不受之后修改的影响
+static bool testRope()
+{
+    srand(7);
+    std::string big(4000, 'R');
+    Wnstring shared(big.data(), big.size());
+    Wnrope rope;
+    std::string ref;
+    std::vector<std::pair<Wnrope, std::string>> snapshots;
+    for (int i = 0; i < 3000; ++i) {
+        int op = rand() % 10;
+        if (op < 5) {
+            std::string piece(1 + rand() % 40, static_cast<char>('a' + i % 26));
+            rope.append(piece.c_str(), piece.size());
+            ref += piece;
+        } else if (op < 6) {
+            rope.append(shared);
+            ref += big;
+        } else if (op < 7) {
+            std::string piece = std::to_string(i);
+            rope.prepend(piece.c_str(), piece.size());
+            ref.insert(0, piece);
+        } else if (op < 8 && !ref.empty()) {
+            size_t pos = rand() % ref.size();
+            size_t n = rand() % (ref.size() - pos + 1);
+            Wnrope part = rope.substr(pos, n);
+            rope.append(part);
+            ref += ref.substr(pos, n);
+        } else if (op < 9 && ref.size() > 100000) {
+            size_t pos = rand() % 1000;
+            rope = rope.substr(pos, 50000);
+            ref = ref.substr(pos, 50000);
+        } else if (i % 100 == 0) {
+            snapshots.emplace_back(rope, ref);
+        }
+    }
+    Wnstring flat = rope.flatten();
+    if (flat.size() != ref.size() || memcmp(flat.c_str(), ref.data(), ref.size()) != 0 || rope[ref.size() / 2] != ref[ref.size() / 2]) {
+        cout << "rope mismatch" << endl;
+        return false;
+    }
+    for (auto& snap : snapshots) {
+        Wnstring f = snap.first.flatten();
+        if (f.size() != snap.second.size() || memcmp(f.c_str(), snap.second.data(), f.size()) != 0) {
+            cout << "rope snapshot changed" << endl;
+            return false;
+        }
+    }
+    // 从中间偏移开始按 iovec 分段取回
+    size_t offset = 12345;
+    std::string gathered;
+    struct iovec iov[16];
+    while (offset < rope.size()) {
+        int n = rope.fillIovec(offset, iov, 16);
+        for (int i = 0; i < n; ++i) {
+            gathered.append(static_cast<char*>(iov[i].iov_base), iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+    }
+    if (gathered != ref.substr(12345)) {
+        cout << "rope iovec mismatch" << endl;
+        return false;
+    }
+
+    // 逐字节追加：原地写进最右叶子，叶子数与树高保持很小
+    Wnrope bytes;
+    for (int i = 0; i < 100000; ++i) {
+        bytes.append("x", 1);
+    }
+    Wnrope whole(shared);
+    return bytes.size() == 100000 && bytes.leafCount() < 100000 / 200 && bytes.height() < 20
+        && whole.flatten().c_str() == shared.c_str();
+}
+
+// 多线程驻留同一批键，每个键只得到一个共享块；哈希与视图、std::hash 一致
+static bool testIntern()
+{
+    std::unordered_set<uint64_t> seen;
+    for (int i = 0; i < 200000; ++i) {
+        std::string key = "key" + std::to_string(i) + std::string(i % 300, 'k');
+        seen.insert(Wnstring(key.data(), key.size()).hash());
+    }
+    if (seen.size() != 200000) {
+        cout << "hash collision" << endl;
+        return false;
+    }
+
+    WnstringInternPool pool;
+    std::vector<std::vector<Wnstring>> results(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, &results, t] {
+            for (int i = 0; i < 5000; ++i) {
+                std::string key = "/usr/lib/" + std::to_string((i * 7 + t) % 1000);
+                results[t].push_back(pool.intern(key.data(), key.size()));
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    Wnstring probe;
+    if (pool.size() != 1000 || !pool.find("/usr/lib/42", 11, &probe)) {
+        cout << "intern pool size mismatch" << endl;
+        return false;
+    }
+    for (auto& r : results) {
+        for (Wnstring& s : r) {
+            Wnstring again = pool.intern(s);
+            if (again.c_str() != s.c_str()) {
+                cout << "interned strings not shared" << endl;
+                return false;
+            }
+        }
+    }
+    std::string big(1000, 'i');
+    Wnstring large(big.data(), big.size());
+    Wnstring adopted = pool.intern(large);
+
+    // Scope 内入池的副本不能落进 arena：arena 释放后池里的串仍然可用
+    std::string path = "/var/cache/" + std::string(40, 'c');
+    {
+        WnstringArena arena;
+        {
+            WnstringArena::Scope scope(arena);
+            Wnstring scoped(big.data(), big.size() - 1);
+            pool.intern(path.data(), path.size());
+            if (pool.intern(scoped).c_str() == scoped.c_str()) {
+                cout << "intern adopted an arena block" << endl;
+                return false;
+            }
+        }
+        arena.release();
+    }
+    Wnstring fromScope;
+    if (!pool.find(path.data(), path.size(), &fromScope) || fromScope.arena()
+        || !pool.find(big.data(), big.size() - 1, &fromScope) || fromScope.arena()
+        || memcmp(fromScope.c_str(), big.data(), big.size() - 1) != 0) {
+        cout << "interned string lost with the arena" << endl;
+        return false;
+    }
+    return adopted.c_str() == large.c_str() && probe.hash() == WnstringView("/usr/lib/42").hash()
+        && std::hash<Wnstring>()(probe) == probe.hash();
+}
+
+// 写线程插入/删除的同时读线程查找；最后与单线程得到的期望内容对照
+static bool testMap()
+{
+    WnstringMap<int> map;
+    std::atomic<bool> stop(false);
+    std::atomic<long> hits(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&map, t] {
+            for (int i = t; i < 40000; i += 4) {
+                std::string key = (i % 3 ? "/srv/www/" : "/") + std::to_string(i);
+                map.insert(Wnstring(key.data(), key.size()), i);
+                if (i % 5 == 0) {
+                    map.erase(Wnstring(key.data(), key.size()));
+                }
+            }
+        });
+    }
+    threads.emplace_back([&map, &stop, &hits] {
+        while (!stop.load()) {
+            for (int i = 0; i < 40000; i += 97) {
+                std::string key = (i % 3 ? "/srv/www/" : "/") + std::to_string(i);
+                int v;
+                if (map.find(key.data(), key.size(), &v)) {
+                    hits += (v == i);
+                }
+            }
+        }
+    });
+    for (int t = 0; t < 4; ++t) {
+        threads[t].join();
+    }
+    stop = true;
+    threads.back().join();
+
+    if (map.size() != 32000) {
+        cout << "map size mismatch " << map.size() << endl;
+        return false;
+    }
+    for (int i = 0; i < 40000; ++i) {
+        std::string key = (i % 3 ? "/srv/www/" : "/") + std::to_string(i);
+        int v = -1;
+        bool found = map.find(key.data(), key.size(), &v);
+        if (found != (i % 5 != 0) || (found && v != i)) {
+            cout << "map content mismatch at " << i << endl;
+            return false;
+        }
+    }
+    Wnstring counter("counter", 7);
+    for (int i = 0; i < 10; ++i) {
+        map.update(counter, [](int& v) { ++v; });
+    }
+    map.insert_or_assign(Wnstring("/0", 2), 7);
+    long sum = 0;
+    map.forEach([&sum](const Wnstring&, const int& v) { sum += v; });
+    int c = 0;
+    map.find(counter, &c);
+    if (c != 10 || !map.contains(Wnstring("/0", 2)) || sum <= 0) {
+        cout << "map update failed" << endl;
+        return false;
+    }
+
+    // Scope 内插入的 key 存在堆上：堆上的 43 字节 key 和 arena 上的 large key 在 arena 释放后都还能查到
+    std::string mediumKey(43, 'm'), largeKey(300, 'l');
+    Wnstring heapKey(mediumKey.data(), mediumKey.size());
+    {
+        WnstringArena arena;
+        {
+            WnstringArena::Scope scope(arena);
+            map.insert(heapKey, 43);
+            map.insert(Wnstring(largeKey.data(), largeKey.size()), 300);
+        }
+        arena.release();
+    }
+    int m = 0, l = 0;
+    if (!map.find(mediumKey.data(), mediumKey.size(), &m) || !map.find(largeKey.data(), largeKey.size(), &l)
+        || m != 43 || l != 300) {
+        cout << "map key lost with the arena" << endl;
+        return false;
+    }
+
+    // Wnstring 值同样不能指向 arena：insert、insert_or_assign 和 update 写进去的 large(COW 共享)
+    // 与 medium 值在 arena 释放后都还能读出
+    WnstringMap<Wnstring> strings;
+    std::string largeValue(300, 'v'), mediumValue(100, 'w');
+    Wnstring assigned("assigned", 8), updated("updated", 7);
+    strings.insert(assigned, Wnstring("old", 3));
+    {
+        WnstringArena arena;
+        {
+            WnstringArena::Scope scope(arena);
+            Wnstring large(largeValue.data(), largeValue.size());
+            Wnstring medium(mediumValue.data(), mediumValue.size());
+            strings.insert(Wnstring("large", 5), large);
+            strings.insert(Wnstring("medium", 6), medium);
+            strings.insert_or_assign(assigned, large);
+            strings.update(updated, [&large](Wnstring& v) { v = large; });
+        }
+        arena.release();
+    }
+    Wnstring lv, mv, av, uv;
+    if (!strings.find(Wnstring("large", 5), &lv) || !strings.find(Wnstring("medium", 6), &mv)
+        || !strings.find(assigned, &av) || !strings.find(updated, &uv) || std::string(lv.c_str(), lv.size()) != largeValue
+        || std::string(mv.c_str(), mv.size()) != mediumValue || !(av == lv) || !(uv == lv)
+        || lv.arena() || mv.arena() || av.arena() || uv.arena()) {
+        cout << "map value lost with the arena" << endl;
+        return false;
+    }
+
+    // 值的构造抛异常时槽位不能留成满槽
+    struct Throwing {
+        Throwing() = default;
+        Throwing(const Throwing& rhs): fail(rhs.fail)
+        {
+            if (fail) {
+                throw std::runtime_error("copy");
+            }
+        }
+        Throwing& operator=(const Throwing&) = default;
+        bool fail = false;
+    };
+    WnstringMap<Throwing> throwing;
+    Throwing bad;
+    bad.fail = true;
+    try {
+        throwing.insert(counter, bad);
+    } catch (const std::runtime_error&) {
+    }
+    size_t visited = 0;
+    throwing.forEach([&visited](const Wnstring&, const Throwing&) { ++visited; });
+    return throwing.size() == 0 && visited == 0 && !throwing.contains(counter) && throwing.insert(counter, Throwing())
+        && throwing.contains(counter);
+}
+
+// 数值与字符串互转：整数写进 SSO 缓冲，解析区分非法输入和溢出
+static bool testNumbers()
+{
+    const long long ints[] = { 0, 7, -7, 42, 99999999, 100000000, -123456789012345LL, INT64_MAX, INT64_MIN };
+    for (long long v : ints) {
+        Wnstring s = Wnstring::fromInt(v);
+        int64_t back = 0;
+        if (s != Wnstring(std::to_string(v).c_str(), std::to_string(v).size()) || s.capacity() != 23
+            || !s.toInt(&back) || back != v) {
+            cout << "int round trip failed for " << v << endl;
+            return false;
+        }
+    }
+    if (Wnstring::fromUnsigned(UINT64_MAX) != Wnstring("18446744073709551615", 20)) {
+        cout << "unsigned format failed" << endl;
+        return false;
+    }
+    const char* bad[] = { "", "-", "+", "12a", " 1", "1 ", "--1", "+-1", "0x10" };
+    for (const char* b : bad) {
+        int64_t v = 5;
+        WnstringParseError err = WnstringParseError::kNone;
+        if (Wnstring(b, strlen(b)).toInt(&v, &err) || err != WnstringParseError::kInvalid || v != 5) {
+            cout << "accepted bad int \"" << b << "\"" << endl;
+            return false;
+        }
+    }
+    WnstringParseError err = WnstringParseError::kNone;
+    int64_t v;
+    if (Wnstring("9223372036854775808", 19).toInt(&v, &err) || err != WnstringParseError::kOverflow
+        || !Wnstring("-9223372036854775808", 20).toInt(&v) || v != INT64_MIN || !Wnstring("+0012", 5).toInt(&v)
+        || v != 12) {
+        cout << "int overflow handling failed" << endl;
+        return false;
+    }
+
+    const double doubles[] = { 0.0, 1.5, -0.1, 1e300, 2.2250738585072014e-308, -2.2250738585072014e-308, 3.141592653589793 };
+    for (double d : doubles) {
+        Wnstring s = Wnstring::fromDouble(d);
+        double back = 0;
+        if (!s.toDouble(&back) || back != d) {
+            cout << "double round trip failed for " << s.c_str() << endl;
+            return false;
+        }
+    }
+    double d = 0;
+    return Wnstring::fromDouble(0.1) == Wnstring("0.1", 3) && Wnstring("+2.5e3", 6).toDouble(&d) && d == 2500
+        && !Wnstring("1e999", 5).toDouble(&d, &err) && err == WnstringParseError::kOverflow
+        && !Wnstring("1.5x", 4).toDouble(&d, &err) && err == WnstringParseError::kInvalid;
+}
+
+static bool testUtf8()
+{
+    auto str = [](const char* s) { return Wnstring(s, strlen(s)); };
+    // 2/3/4 字节字符，跨 32 字节块边界
+    Wnstring text = str("h\xC3\xA9llo \xE4\xB8\x96\xE7\x95\x8C \xF0\x9F\x98\x80 ");
+    for (int i = 0; i < 5; ++i) {
+        text.append(text);
+    }
+    if (!text.validUtf8()) {
+        cout << "valid utf-8 rejected" << endl;
+        return false;
+    }
+    const char* bad[] = { "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xF8\x88\x80\x80\x80",
+        "\x80", "\xE4\xB8", "a\xC3" };
+    for (const char* b : bad) {
+        Wnstring s = text;
+        s.append(b);
+        Wnstring t = str(b);
+        t.append(text);
+        if (s.validUtf8() || t.validUtf8()) {
+            cout << "invalid utf-8 accepted" << endl;
+            return false;
+        }
+    }
+
+    std::u16string wide;
+    Wnstring back;
+    if (!text.toUtf16(&wide) || wide.size() != 12 * 32 || wide[1] != 0xE9 || wide[9] != 0xD83D
+        || !Wnstring::fromUtf16(wide.data(), wide.size(), &back) || back != text) {
+        cout << "utf-16 round trip failed" << endl;
+        return false;
+    }
+    const char16_t lone[] = { u'a', 0xD800, u'b' };
+    if (Wnstring::fromUtf16(lone, 3, &back) || back != text || Wnstring("\xFF", 1).toUtf16(&wide)) {
+        cout << "bad utf-16 accepted" << endl;
+        return false;
+    }
+
+    // 没有需要转换的字母时不 unshare
+    Wnstring lower;
+    lower.resize(300, 'x');
+    Wnstring shared = lower;
+    Wnstring upper;
+    upper.resize(300, 'X');
+    lower.toLowerAscii();
+    if (lower.c_str() != shared.c_str()) {
+        cout << "toLowerAscii unshared needlessly" << endl;
+        return false;
+    }
+    lower.toUpperAscii();
+    if (lower.c_str() == shared.c_str() || lower != upper || shared.c_str()[0] != 'x') {
+        cout << "toUpperAscii failed" << endl;
+        return false;
+    }
+    Wnstring mixed = str("Hello, \xC3\x89t\xC3\xA9 World[@`{]");
+    mixed.toUpperAscii();
+    return mixed == str("HELLO, \xC3\x89T\xC3\xA9 WORLD[@`{]");
+}
+
+// StringBuilder 与 LogStream 的输出逐字节一致；release() 交出缓冲不复制
+static bool testBuilder()
+{
+    Wnstring name("wnstring", 8);
+    const unsigned char digest[] = { 0xde, 0xad, 0xbe, 0xef };
+    LogStream stream;
+    stream << name << ' ' << name.substr(1, 3) << ' ' << -42 << ' ' << 18446744073709551615ULL << ' ' << 3.25 << ' '
+           << true << ' ' << static_cast<const void*>(digest) << ' ' << Hex(digest, 4);
+    StringBuilder builder;
+    builder << name << ' ' << name.substr(1, 3) << ' ' << -42 << ' ' << 18446744073709551615ULL << ' ' << 3.25 << ' '
+            << true << ' ' << static_cast<const void*>(digest) << ' ' << Hex(digest, 4);
+    const std::string expected = stream.buffer().toString();
+    if (builder.size() != expected.size() || memcmp(builder.data(), expected.data(), expected.size()) != 0) {
+        cout << "builder output differs from LogStream: " << builder.data() << endl;
+        return false;
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        builder << " item=" << i;
+    }
+    const char* buffer = builder.data();
+    const size_t size = builder.size();
+    Wnstring result = builder.release();
+    if (result.c_str() != buffer || result.size() != size || builder.size() != 0) {
+        cout << "release copied the buffer" << endl;
+        return false;
+    }
+    // 短结果留在 SSO 缓冲
+    Wnstring small = (StringBuilder() << "id=" << 7).release();
+    return small == Wnstring("id=7", 4) && small.capacity() == maxSmallSize;
+}
+
+int main(int argc, char const *argv[])
+{
+    bool ok = testGrowth() && testCow() && testMove() && testSearch() && testCompare() && testView() && testAllocator()
+        && testLocal() && testRope() && testIntern() && testMap()
+        && testNumbers() && testUtf8() && testBuilder();
+    cout << (ok ? "wnstring ok" : "wnstring FAIL") << endl;
+    return ok ? 0 : 1;
 }
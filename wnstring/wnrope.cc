@@ -0,0 +1,418 @@
+#include "wnrope.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+using detail::RopeNode;
+
+static RopeNode* allocNode(size_t dataSize)
+{
+    size_t size = std::max(sizeof(RopeNode), offsetof(RopeNode, data_) + dataSize);
+    // 节点在 rope 之间共享，可能被比当前 Scope 活得久的 rope 引用，总在堆上分配
+    WnstringArena::Suspend suspend;
+    bool arena;
+    auto node = static_cast<RopeNode*>(detail::stringAllocate(&size, &arena));
+    new (&node->refs_) std::atomic<size_t>(1);
+    node->allocSize_ = size;
+    node->capacity_ = size - offsetof(RopeNode, data_);
+    node->height_ = 0;
+    node->left_ = nullptr;
+    node->right_ = nullptr;
+    return node;
+}
+
+static void freeNode(RopeNode* node)
+{
+    if (node->kind_ == RopeNode::kShared) {
+        reinterpret_cast<WnstringView*>(node->view_)->~WnstringView();
+    }
+    detail::stringDeallocate(node, node->allocSize_, false);
+}
+
+static void ref(RopeNode* node)
+{
+    AtomicRefs::increment(node->refs_);
+}
+
+static void unref(RopeNode* node)
+{
+    if (AtomicRefs::decrement(node->refs_) == 1) {
+        if (node->kind_ == RopeNode::kConcat) {
+            unref(node->left_);
+            unref(node->right_);
+        }
+        freeNode(node);
+    }
+}
+
+static bool unique(const RopeNode* node)
+{
+    return AtomicRefs::load(node->refs_) == 1;
+}
+
+// 内联叶子。reserve 为之后原地追加预留容量
+static RopeNode* newInline(const char* s, size_t n, size_t reserve)
+{
+    RopeNode* node = allocNode(std::max(n, reserve));
+    node->kind_ = RopeNode::kInline;
+    node->length_ = n;
+    memcpy(node->data_, s, n);
+    return node;
+}
+
+static RopeNode* newShared(WnstringView view)
+{
+    RopeNode* node = allocNode(0);
+    node->kind_ = RopeNode::kShared;
+    node->length_ = view.size();
+    new (node->view_) WnstringView(std::move(view));
+    return node;
+}
+
+// n > 0。短片段复制，长片段复制一次成 large string 后共享
+static RopeNode* leafFrom(const char* s, size_t n)
+{
+    if (n <= Wnrope::kMaxInline) {
+        return newInline(s, n, Wnrope::kMaxInline);
+    }
+    WnstringArena::Suspend suspend;
+    return newShared(WnstringView(Wnstring(s, n)));
+}
+
+// arena 上的块不共享，复制到堆上
+static RopeNode* leafFrom(const Wnstring& s)
+{
+    WnstringView view(s);
+    if (view.shared() && !s.arena()) {
+        return newShared(std::move(view));
+    }
+    return leafFrom(s.c_str(), s.size());
+}
+
+static RopeNode* makeConcat(RopeNode* left, RopeNode* right)
+{
+    RopeNode* node = allocNode(0);
+    node->kind_ = RopeNode::kConcat;
+    node->length_ = left->length_ + right->length_;
+    node->height_ = static_cast<uint8_t>(std::max(left->height_, right->height_) + 1);
+    node->left_ = left;
+    node->right_ = right;
+    return node;
+}
+
+// 拆开一个拼接节点，取得两个孩子的引用。唯一持有时直接拿走孩子，省掉计数操作
+static void take(RopeNode* node, RopeNode** left, RopeNode** right)
+{
+    *left = node->left_;
+    *right = node->right_;
+    if (unique(node)) {
+        freeNode(node);
+    } else {
+        ref(*left);
+        ref(*right);
+        unref(node);
+    }
+}
+
+// 两棵子树高度差不超过 2，必要时单旋或双旋
+static RopeNode* balance(RopeNode* left, RopeNode* right)
+{
+    if (left->height_ > right->height_ + 1) {
+        RopeNode *ll, *lr;
+        take(left, &ll, &lr);
+        if (ll->height_ >= lr->height_) {
+            return makeConcat(ll, makeConcat(lr, right));
+        }
+        RopeNode *lrl, *lrr;
+        take(lr, &lrl, &lrr);
+        return makeConcat(makeConcat(ll, lrl), makeConcat(lrr, right));
+    }
+    if (right->height_ > left->height_ + 1) {
+        RopeNode *rl, *rr;
+        take(right, &rl, &rr);
+        if (rr->height_ >= rl->height_) {
+            return makeConcat(makeConcat(left, rl), rr);
+        }
+        RopeNode *rll, *rlr;
+        take(rl, &rll, &rlr);
+        return makeConcat(makeConcat(left, rll), makeConcat(rlr, rr));
+    }
+    return makeConcat(left, right);
+}
+
+// AVL join：沿较高一侧的边缘下降到高度相近处再拼接，代价 O(高度差)。
+// 消耗 left、right 的引用，返回新引用。相邻的短叶子合并，避免逐字节拼接产生大量小叶子
+static RopeNode* join(RopeNode* left, RopeNode* right)
+{
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+    const size_t total = left->length_ + right->length_;
+    if (left->kind_ != RopeNode::kConcat && right->kind_ != RopeNode::kConcat && total <= Wnrope::kMaxInline) {
+        if (left->kind_ == RopeNode::kInline && unique(left) && total <= left->capacity_) {
+            memcpy(left->data_ + left->length_, right->leafData(), right->length_);
+            left->length_ = total;
+            unref(right);
+            return left;
+        }
+        RopeNode* merged = newInline(left->leafData(), left->length_, Wnrope::kMaxInline);
+        memcpy(merged->data_ + left->length_, right->leafData(), right->length_);
+        merged->length_ = total;
+        unref(left);
+        unref(right);
+        return merged;
+    }
+    if (left->height_ > right->height_ + 1) {
+        RopeNode *ll, *lr;
+        take(left, &ll, &lr);
+        return balance(ll, join(lr, right));
+    }
+    if (right->height_ > left->height_ + 1) {
+        RopeNode *rl, *rr;
+        take(right, &rl, &rr);
+        return balance(join(left, rl), rr);
+    }
+    return makeConcat(left, right);
+}
+
+// 沿右边缘都是唯一持有时，直接写进最右的内联叶子
+static bool appendInPlace(RopeNode* node, const char* s, size_t n)
+{
+    if (!unique(node)) {
+        return false;
+    }
+    if (node->kind_ == RopeNode::kConcat) {
+        if (!appendInPlace(node->right_, s, n)) {
+            return false;
+        }
+    } else if (node->kind_ != RopeNode::kInline || node->length_ + n > node->capacity_) {
+        return false;
+    } else {
+        memcpy(node->data_ + node->length_, s, n);
+    }
+    node->length_ += n;
+    return true;
+}
+
+// 返回 [pos, pos+n) 的新引用，n > 0 且不越界
+static RopeNode* subtree(RopeNode* node, size_t pos, size_t n)
+{
+    if (pos == 0 && n == node->length_) {
+        ref(node);
+        return node;
+    }
+    switch (node->kind_) {
+    case RopeNode::kInline:
+        return newInline(node->data_ + pos, n, 0);
+    case RopeNode::kShared:
+        return newShared(node->view().substr(pos, n));
+    case RopeNode::kConcat:
+        break;
+    }
+    const size_t leftLength = node->left_->length_;
+    if (pos + n <= leftLength) {
+        return subtree(node->left_, pos, n);
+    }
+    if (pos >= leftLength) {
+        return subtree(node->right_, pos - leftLength, n);
+    }
+    return join(subtree(node->left_, pos, leftLength - pos), subtree(node->right_, 0, pos + n - leftLength));
+}
+
+static size_t countLeaves(const RopeNode* node)
+{
+    return node->kind_ == RopeNode::kConcat ? countLeaves(node->left_) + countLeaves(node->right_) : 1;
+}
+
+Wnrope::Wnrope(const char* s, size_t n)
+    : root_(n ? leafFrom(s, n) : nullptr)
+{
+}
+
+Wnrope::Wnrope(const Wnstring& s)
+    : root_(s.empty() ? nullptr : leafFrom(s))
+{
+}
+
+Wnrope::Wnrope(const Wnrope& rhs) noexcept
+    : root_(rhs.root_)
+{
+    if (root_) {
+        ref(root_);
+    }
+}
+
+Wnrope::~Wnrope()
+{
+    clear();
+}
+
+void Wnrope::clear()
+{
+    if (root_) {
+        unref(root_);
+        root_ = nullptr;
+    }
+}
+
+char Wnrope::operator[](size_t pos) const
+{
+    assert(pos < size());
+    const RopeNode* node = root_;
+    while (node->kind_ == RopeNode::kConcat) {
+        if (pos < node->left_->length_) {
+            node = node->left_;
+        } else {
+            pos -= node->left_->length_;
+            node = node->right_;
+        }
+    }
+    return node->leafData()[pos];
+}
+
+Wnrope& Wnrope::append(const char* s, size_t n)
+{
+    if (n == 0) {
+        return *this;
+    }
+    if (root_ && n <= kMaxInline && appendInPlace(root_, s, n)) {
+        return *this;
+    }
+    root_ = join(root_, leafFrom(s, n));
+    return *this;
+}
+
+Wnrope& Wnrope::append(const Wnstring& s)
+{
+    if (s.empty()) {
+        return *this;
+    }
+    if (root_ && s.size() <= kMaxInline && appendInPlace(root_, s.c_str(), s.size())) {
+        return *this;
+    }
+    root_ = join(root_, leafFrom(s));
+    return *this;
+}
+
+Wnrope& Wnrope::append(const Wnrope& rope)
+{
+    if (rope.root_) {
+        ref(rope.root_);
+        root_ = join(root_, rope.root_);
+    }
+    return *this;
+}
+
+Wnrope& Wnrope::prepend(const char* s, size_t n)
+{
+    if (n) {
+        root_ = join(leafFrom(s, n), root_);
+    }
+    return *this;
+}
+
+Wnrope& Wnrope::prepend(const Wnstring& s)
+{
+    if (!s.empty()) {
+        root_ = join(leafFrom(s), root_);
+    }
+    return *this;
+}
+
+Wnrope& Wnrope::prepend(const Wnrope& rope)
+{
+    if (rope.root_) {
+        ref(rope.root_);
+        root_ = join(rope.root_, root_);
+    }
+    return *this;
+}
+
+Wnrope Wnrope::substr(size_t pos, size_t n) const
+{
+    assert(pos <= size());
+    pos = std::min(pos, size());
+    n = std::min(n, size() - pos);
+    return Wnrope(n ? subtree(root_, pos, n) : nullptr);
+}
+
+Wnstring Wnrope::flatten() const
+{
+    if (!root_) {
+        return Wnstring();
+    }
+    if (root_->kind_ == RopeNode::kShared) {
+        return root_->view().str();
+    }
+    Wnstring result;
+    result.reserve(size());
+    for (ChunkIterator it(*this); !it.done(); ++it) {
+        WnstringView chunk = *it;
+        result.append(chunk.data(), chunk.size());
+    }
+    return result;
+}
+
+int Wnrope::fillIovec(size_t offset, struct iovec* iov, int iovcnt) const
+{
+    int count = 0;
+    for (ChunkIterator it(*this, offset); count < iovcnt && !it.done(); ++it) {
+        WnstringView chunk = *it;
+        iov[count].iov_base = const_cast<char*>(chunk.data());
+        iov[count].iov_len = chunk.size();
+        ++count;
+    }
+    return count;
+}
+
+size_t Wnrope::leafCount() const
+{
+    return root_ ? countLeaves(root_) : 0;
+}
+
+Wnrope::ChunkIterator::ChunkIterator(const Wnrope& rope, size_t offset)
+    : depth_(0)
+    , leaf_(nullptr)
+    , offset_(0)
+{
+    const RopeNode* node = rope.root_;
+    if (!node || offset >= node->length_) {
+        return;
+    }
+    while (node->kind_ == RopeNode::kConcat) {
+        if (offset < node->left_->length_) {
+            stack_[depth_++] = node->right_;
+            node = node->left_;
+        } else {
+            offset -= node->left_->length_;
+            node = node->right_;
+        }
+    }
+    leaf_ = node;
+    offset_ = offset;
+}
+
+Wnrope::ChunkIterator& Wnrope::ChunkIterator::operator++()
+{
+    offset_ = 0;
+    if (depth_ == 0) {
+        leaf_ = nullptr;
+    } else {
+        descend(stack_[--depth_]);
+    }
+    return *this;
+}
+
+void Wnrope::ChunkIterator::descend(const RopeNode* node)
+{
+    while (node->kind_ == RopeNode::kConcat) {
+        assert(depth_ < kMaxDepth);
+        stack_[depth_++] = node->right_;
+        node = node->left_;
+    }
+    leaf_ = node;
+}
@@ -0,0 +1,129 @@
+#ifndef WNROPE_H
+#define WNROPE_H
+
+#include "wnstring.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h> // iovec
+
+// 由 Wnstring 片段拼成的绳(rope)。
+// 叶子有两种：large string 的共享片段(持有 RefCounted 引用，不复制)和内联的短字节串；
+// 内部节点是按 AVL 高度平衡的拼接节点。节点不可变并以引用计数共享，
+// 拷贝 Wnrope 只增加根的计数，append/prepend/substr 都只新建 O(log n) 个节点。
+// 逐段拼接的响应因此是线性的，写出时可以直接按叶子填 iovec 交给 writev，
+// 只有确实需要连续内存时才 flatten。
+
+namespace detail {
+
+struct RopeNode {
+    enum Kind : uint8_t {
+        kConcat,
+        kShared, // view_ 指向 large string 的 RefCounted 块
+        kInline, // data_ 存放字节
+    };
+
+    std::atomic<size_t> refs_;
+    size_t length_;
+    size_t allocSize_; // 释放时需要
+    size_t capacity_; // 内联叶子可容纳的字节数
+    uint8_t height_; // 叶子为 0
+    Kind kind_;
+    RopeNode* left_;
+    RopeNode* right_;
+    alignas(WnstringView) unsigned char view_[sizeof(WnstringView)];
+    char data_[1]; // flexible array，仅内联叶子使用
+
+    const WnstringView& view() const { return *reinterpret_cast<const WnstringView*>(view_); }
+    const char* leafData() const { return kind_ == kShared ? view().data() : data_; }
+};
+
+} // namespace detail
+
+class Wnrope {
+public:
+    static constexpr size_t npos = Wnstring::npos;
+    // 不超过此长度的片段复制进内联叶子，更长的转成 large string 共享
+    static constexpr size_t kMaxInline = maxMediumSize;
+
+    Wnrope() noexcept: root_(nullptr) {}
+    Wnrope(const char* s, size_t n);
+    explicit Wnrope(const Wnstring& s);
+    Wnrope(const Wnrope& rhs) noexcept;
+    Wnrope(Wnrope&& goner) noexcept: root_(goner.root_) { goner.root_ = nullptr; }
+    ~Wnrope();
+
+    Wnrope& operator=(Wnrope rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+    void swap(Wnrope& rhs) noexcept
+    {
+        detail::RopeNode* t = root_;
+        root_ = rhs.root_;
+        rhs.root_ = t;
+    }
+
+    size_t size() const { return root_ ? root_->length_ : 0; }
+    bool empty() const { return root_ == nullptr; }
+    void clear();
+    // O(log n) 定位
+    char operator[](size_t pos) const;
+
+    // 末尾是唯一持有的内联叶子且放得下时原地追加，否则新建叶子后做 AVL join
+    Wnrope& append(const char* s, size_t n);
+    Wnrope& append(const char* s) { return append(s, strlen(s)); }
+    Wnrope& append(const Wnstring& s);
+    Wnrope& append(const Wnrope& rope);
+    Wnrope& prepend(const char* s, size_t n);
+    Wnrope& prepend(const Wnstring& s);
+    Wnrope& prepend(const Wnrope& rope);
+    Wnrope& operator+=(const Wnrope& rope) { return append(rope); }
+
+    // 与原绳共享节点和叶子块，不复制数据(内联叶子的边角除外)
+    Wnrope substr(size_t pos, size_t n = npos) const;
+
+    // 拼成连续的 Wnstring。整条绳只是一个完整的共享块时直接共享，否则复制一次
+    Wnstring flatten() const;
+
+    // 按顺序遍历各段数据。返回的视图只借用叶子，不能比 Wnrope 活得久
+    class ChunkIterator {
+    public:
+        ChunkIterator(const Wnrope& rope, size_t offset = 0);
+        bool done() const { return leaf_ == nullptr; }
+        WnstringView operator*() const
+        {
+            return WnstringView(leaf_->leafData() + offset_, leaf_->length_ - offset_);
+        }
+        ChunkIterator& operator++();
+
+    private:
+        // AVL 高度不超过 1.44*log2(n)，64 位地址空间内 96 层足够
+        static constexpr int kMaxDepth = 96;
+
+        void descend(const detail::RopeNode* node);
+
+        const detail::RopeNode* stack_[kMaxDepth];
+        int depth_;
+        const detail::RopeNode* leaf_;
+        size_t offset_; // 仅第一段可能从叶子中间开始
+    };
+    ChunkIterator chunks(size_t offset = 0) const { return ChunkIterator(*this, offset); }
+
+    // 从 offset 开始按段填 iovec，返回填了几个。配合 writev 的部分写：
+    //   offset += writev(fd, iov, rope.fillIovec(offset, iov, 64));
+    int fillIovec(size_t offset, struct iovec* iov, int iovcnt) const;
+
+    // 叶子数和树高，便于观察拼接模式
+    size_t leafCount() const;
+    int height() const { return root_ ? root_->height_ : 0; }
+
+private:
+    explicit Wnrope(detail::RopeNode* root): root_(root) {}
+
+    detail::RopeNode* root_;
+};
+
+#endif // WNROPE_H
@@ -1,10 +1,18 @@
 #include "wnstring.h"
+#include "../wnlogging/wndigits.h"
+#include "wnstringhash.h"
+#include "wnstringsearch.h"
+#include "wnstringutf8.h"
 
+#include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <utility>
 #include <sys/types.h> // for ssize_t
 using namespace std;
 
-Wnstring::Wnstring(const char* const data, const size_t size, bool disableSSO)
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>::BasicWnstring(const char* const data, const size_t size, bool disableSSO)
 {
     if (!disableSSO && size <= maxSmallSize) {
         initSmall(data, size);
@@ -15,7 +23,8 @@ Wnstring::Wnstring(const char* const data, const size_t size, bool disableSSO)
         initLarge(data, size);
     }
 }
-Wnstring::Wnstring(const Wnstring& rhs)
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>::BasicWnstring(const BasicWnstring& rhs)
 {
     assert(&rhs != this);
     switch (rhs.category()) {
@@ -32,10 +41,19 @@ Wnstring::Wnstring(const Wnstring& rhs)
         break;
     }
 }
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>::BasicWnstring(BasicWnstring&& goner) noexcept
+{
+    ml_ = goner.ml_;
+    goner.setSmallSize(0);
+}
 // 首先，如果传入的字符串地址是内存对齐的，则配合 reinterpret_cast 进行 word-wise copy，提高效率。
 // 否则，调用 podCopy 进行 memcpy。
 // 最后，通过 setSmallSize 设置 small string 的 size。
-void Wnstring::initSmall(const char* const data, const size_t size)
+// 按对齐的字读取可能越过字符串末尾，但不会跨出所在的字(也就不会跨页)，对 ASan 关闭检查。
+// 成员模板的属性要写在类内声明上
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::initSmall(const char* const data, const size_t size)
 {
     if ((reinterpret_cast<size_t>(data) & (sizeof(size_t) - 1)) == 0) {
         const size_t byteSize = size * sizeof(char);
@@ -43,10 +61,10 @@ void Wnstring::initSmall(const char* const data, const size_t size)
         switch ((byteSize + wordWidth - 1) / wordWidth) { // Number of words.
         case 3:
             ml_.capacity_ = reinterpret_cast<const size_t*>(data)[2];
-            break;
+            [[fallthrough]];
         case 2:
             ml_.size_ = reinterpret_cast<const size_t*>(data)[1];
-            break;
+            [[fallthrough]];
         case 1:
             ml_.data_ = *reinterpret_cast<char**>(const_cast<char*>(data));
             break;
@@ -61,58 +79,68 @@ void Wnstring::initSmall(const char* const data, const size_t size)
     setSmallSize(size);
 }
 
-void Wnstring::initMedium(const char* const data, const size_t size)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::initMedium(const char* const data, const size_t size)
 {
-    auto const allocSize = (1 + size) * sizeof(char);
-    ml_.data_ = new char[allocSize];
+    size_t allocSize = (1 + size) * sizeof(char);
+    bool arena;
+    ml_.data_ = static_cast<char*>(detail::stringAllocate(&allocSize, &arena));
     memcpy(ml_.data_, data, size);
     ml_.size_ = size;
-    ml_.setCapacity(allocSize - 1, Category::isMedium);
+    ml_.setCapacity(allocSize - 1, Category::isMedium, arena);
     ml_.data_[size] = '\0';
 }
-void Wnstring::initLarge(const char* const data, const size_t size)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::initLarge(const char* const data, const size_t size)
 {
     size_t effectiveCapacity = size;
-    auto const newRC = RefCounted::create(data, &effectiveCapacity);
+    bool arena;
+    auto const newRC = RefCounted::create(data, &effectiveCapacity, &arena);
     ml_.data_ = newRC->data_;
     ml_.size_ = size;
-    ml_.setCapacity(effectiveCapacity, Category::isLarge);
+    ml_.setCapacity(effectiveCapacity, Category::isLarge, arena);
     ml_.data_[size] = '\0';
 }
 // 虽然 small strings 的情况下，字符串存储在 small中，
 // 但是我们只需要把 ml直接赋值即可，因为在一个 union 中
-void Wnstring::copySmall(const Wnstring& rhs)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::copySmall(const BasicWnstring& rhs)
 {
     ml_ = rhs.ml_;
 }
-void Wnstring::copyMedium(const Wnstring& rhs)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::copyMedium(const BasicWnstring& rhs)
 {
-    auto const allocSize = (1 + rhs.ml_.size_) * sizeof(char);
-    ml_.data_ = new char[allocSize];
+    size_t allocSize = (1 + rhs.ml_.size_) * sizeof(char);
+    bool arena;
+    ml_.data_ = static_cast<char*>(detail::stringAllocate(&allocSize, &arena));
 
     memcpy(ml_.data_, rhs.ml_.data_, rhs.ml_.size_ + 1);
     ml_.size_ = rhs.ml_.size_;
-    ml_.setCapacity(allocSize - 1, Category::isMedium);
+    ml_.setCapacity(allocSize - 1, Category::isMedium, arena);
 }
 // COW 方式：直接赋值 ml，内含指向共享字符串的指针。
 // 共享字符串的引用计数加 1。
-void Wnstring::copyLarge(const Wnstring& rhs)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::copyLarge(const BasicWnstring& rhs)
 {
     ml_ = rhs.ml_;
     RefCounted::incrementRefs(ml_.data_);
 }
-size_t Wnstring::size() const
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::size() const
 {
     size_t ret = ml_.size_;
     // 如果不是small类型，那么union最后一个字节存的是类型10000000或01000000，它们都必然大于maxSmallSize
     typedef typename std::make_unsigned<char>::type UChar;
     auto maybeSmallSize = size_t(maxSmallSize) - size_t(static_cast<UChar>(small_[maxSmallSize]));
     // 使用这个语法, GCC 和 Clang 会生成 a CMOV（条件传送指令） 而不会进行 “处理器分支预测” 这一步，减少控制冒险
-    ret = (static_cast<size_t>(maybeSmallSize) >= 0) ? maybeSmallSize : ret;
+    ret = (static_cast<ssize_t>(maybeSmallSize) >= 0) ? maybeSmallSize : ret;
 
     return ret;
 }
-bool Wnstring::empty() const
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::empty() const
 {
     return (size() == 0);
 }
@@ -122,7 +150,8 @@ bool Wnstring::empty() const
 // large strings :
 // 当字符串引用大于 1 时，直接返回 size。因为此时的 capacity 是没有意义的，任何 append data 操作都会触发一次 cow
 // 否则，返回 ml_.capacity()。
-size_t Wnstring::capacity() const
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::capacity() const
 {
     switch (category()) {
     case Category::isSmall:
@@ -145,7 +174,8 @@ size_t Wnstring::capacity() const
 // 因为假如存储 size 的话，small中最后两个字节就得是\0 和 size，
 // 但是存储maxSmallSize - size，当 size == maxSmallSize 时，
 // small的最后一个字节恰好也是\0。
-void Wnstring::setSmallSize(size_t s)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::setSmallSize(size_t s)
 {
     assert(s <= maxSmallSize);
     small_[maxSmallSize] = char(maxSmallSize - static_cast<uint8_t>(s));
@@ -154,19 +184,27 @@ void Wnstring::setSmallSize(size_t s)
 }
 
 // 获取字符串类型
-Category Wnstring::category() const
+template <typename RefPolicy>
+Category BasicWnstring<RefPolicy>::category() const
 {
     return static_cast<Category>(bytes_[lastChar] & categoryExtractMask);
 }
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::arena() const
+{
+    return category() != Category::isSmall && ml_.arena();
+}
 
-const char* Wnstring::c_str() const
+template <typename RefPolicy>
+const char* BasicWnstring<RefPolicy>::c_str() const
 {
     const char* ptr = ml_.data_;
     // 使用这个语法, GCC 和 Clang 会生成 a CMOV（条件传送指令） 而不会进行 “处理器分支预测” 这一步，减少控制冒险
     ptr = (category() == Category::isSmall) ? small_ : ptr;
     return ptr;
 }
-char& Wnstring::operator[](size_t pos)
+template <typename RefPolicy>
+char& BasicWnstring<RefPolicy>::operator[](size_t pos)
 {
     char* begin = nullptr;
     switch (category()) {
@@ -184,45 +222,614 @@ char& Wnstring::operator[](size_t pos)
     }
     return *(begin + pos);
 }
-const char& Wnstring::operator[](size_t pos) const
+template <typename RefPolicy>
+const char& BasicWnstring<RefPolicy>::operator[](size_t pos) const
 {
     const char* begin = c_str();
     return *(begin + pos);
 }
-char* Wnstring::mutableDataLarge()
+template <typename RefPolicy>
+char* BasicWnstring<RefPolicy>::mutableDataLarge()
 {
     if (RefCounted::refs(ml_.data_) > 1) { // Ensure unique.
         unshare();
     }
+    // 调用方会修改内容，缓存的哈希作废
+    RefCounted::resetHash(ml_.data_);
     return ml_.data_;
 }
 // 注意此时还不会设置 size，因为还不知道应用程序对字符串进行什么修改。
-void Wnstring::unshare(size_t minCapacity)
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::unshare(size_t minCapacity)
 {
     size_t effectiveCapacity = std::max(minCapacity, ml_.capacity());
 
-    auto const newRC = RefCounted::create(&effectiveCapacity);
+    bool arena;
+    auto const newRC = RefCounted::create(&effectiveCapacity, &arena);
 
     memcpy(newRC->data_, ml_.data_, ml_.size_ + 1);
 
-    RefCounted::decrementRefs(ml_.data_);
+    RefCounted::decrementRefs(ml_.data_, ml_.capacity(), ml_.arena());
     ml_.data_ = newRC->data_;
-    ml_.setCapacity(effectiveCapacity, Category::isLarge);
+    ml_.setCapacity(effectiveCapacity, Category::isLarge, arena);
 }
 
-Wnstring::~Wnstring()
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>::~BasicWnstring()
 {
     if (category() == Category::isSmall) {
         return;
     }
     destroyMediumLarge();
 }
-void Wnstring::destroyMediumLarge()
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::destroyMediumLarge()
 {
     auto const c = category();
     if (c == Category::isMedium) {
-        delete ml_.data_;
+        detail::stringDeallocate(ml_.data_, (ml_.capacity() + 1) * sizeof(char), ml_.arena());
     } else {
-        RefCounted::decrementRefs(ml_.data_);
+        RefCounted::decrementRefs(ml_.data_, ml_.capacity(), ml_.arena());
+    }
+}
+
+// 拷贝后再移动：large string 保持 COW 共享，而不是逐字节复制
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>& BasicWnstring<RefPolicy>::operator=(const BasicWnstring& str)
+{
+    if (&str == this) {
+        return *this;
+    }
+    BasicWnstring tmp(str);
+    return *this = std::move(tmp);
+}
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>& BasicWnstring<RefPolicy>::operator=(BasicWnstring&& goner) noexcept
+{
+    if (&goner == this) {
+        return *this;
+    }
+    if (category() != Category::isSmall) {
+        destroyMediumLarge();
+    }
+    ml_ = goner.ml_;
+    goner.setSmallSize(0);
+    return *this;
+}
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>& BasicWnstring<RefPolicy>::operator=(const char* const s)
+{
+    return assign(s, strlen(s));
+}
+
+// 容量够且不共享时原地覆盖；否则先构造新串再移动过来，s 指向自身也安全
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>& BasicWnstring<RefPolicy>::assign(const char* const s, size_t n)
+{
+    auto const c = category();
+    if (n <= capacity() && (c != Category::isLarge || RefCounted::refs(ml_.data_) == 1)) {
+        if (c == Category::isSmall) {
+            memmove(small_, s, n);
+            setSmallSize(n);
+        } else {
+            if (c == Category::isLarge) {
+                RefCounted::resetHash(ml_.data_);
+            }
+            memmove(ml_.data_, s, n);
+            ml_.size_ = n;
+            ml_.data_[n] = '\0';
+        }
+        return *this;
+    }
+    BasicWnstring tmp(s, n);
+    return *this = std::move(tmp);
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::operator+(const BasicWnstring& rhs) const
+{
+    BasicWnstring result;
+    result.reserve(size() + rhs.size());
+    result.append(*this);
+    result.append(rhs);
+    return result;
+}
+
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::reserve(size_t minCapacity)
+{
+    switch (category()) {
+    case Category::isSmall:
+        reserveSmall(minCapacity);
+        break;
+    case Category::isMedium:
+        reserveMedium(minCapacity);
+        break;
+    case Category::isLarge:
+        reserveLarge(minCapacity);
+        break;
+    default:
+        break;
+    }
+    assert(capacity() >= minCapacity);
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::reserveSmall(size_t minCapacity)
+{
+    if (minCapacity <= maxSmallSize) {
+        return;
+    }
+    auto const size = smallSize();
+    if (minCapacity <= maxMediumSize) {
+        size_t allocSize = (1 + minCapacity) * sizeof(char);
+        bool arena;
+        auto const pData = static_cast<char*>(detail::stringAllocate(&allocSize, &arena));
+        memcpy(pData, small_, size + 1);
+        ml_.data_ = pData;
+        ml_.size_ = size;
+        ml_.setCapacity(allocSize - 1, Category::isMedium, arena);
+    } else {
+        bool arena;
+        auto const newRC = RefCounted::create(&minCapacity, &arena);
+        memcpy(newRC->data_, small_, size + 1);
+        ml_.data_ = newRC->data_;
+        ml_.size_ = size;
+        ml_.setCapacity(minCapacity, Category::isLarge, arena);
+    }
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::reserveMedium(size_t minCapacity)
+{
+    if (minCapacity <= ml_.capacity()) {
+        return;
+    }
+    if (minCapacity <= maxMediumSize) {
+        // 仍是 medium：arena 中的最后一块可以原地扩展
+        size_t allocSize = (1 + minCapacity) * sizeof(char);
+        bool arena = ml_.arena();
+        ml_.data_ = static_cast<char*>(detail::stringReallocate(ml_.data_, (ml_.size_ + 1) * sizeof(char),
+            (ml_.capacity() + 1) * sizeof(char), &allocSize, &arena));
+        ml_.setCapacity(allocSize - 1, Category::isMedium, arena);
+    } else {
+        bool arena;
+        auto const newRC = RefCounted::create(&minCapacity, &arena);
+        memcpy(newRC->data_, ml_.data_, ml_.size_ + 1);
+        detail::stringDeallocate(ml_.data_, (ml_.capacity() + 1) * sizeof(char), ml_.arena());
+        ml_.data_ = newRC->data_;
+        ml_.setCapacity(minCapacity, Category::isLarge, arena);
+    }
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::reserveLarge(size_t minCapacity)
+{
+    if (RefCounted::refs(ml_.data_) > 1) {
+        // 共享时扩容只能复制，顺便按需要的容量分配
+        unshare(minCapacity);
+    } else if (minCapacity > ml_.capacity()) {
+        bool arena = ml_.arena();
+        auto const newRC = RefCounted::reallocate(ml_.data_, ml_.size_, ml_.capacity(), &minCapacity, &arena);
+        ml_.data_ = newRC->data_;
+        ml_.setCapacity(minCapacity, Category::isLarge, arena);
+    }
+}
+
+template <typename RefPolicy>
+char* BasicWnstring<RefPolicy>::expandNoinit(size_t delta)
+{
+    size_t sz, newSz;
+    if (category() == Category::isSmall) {
+        sz = smallSize();
+        newSz = sz + delta;
+        if (newSz <= maxSmallSize) {
+            setSmallSize(newSz);
+            return small_ + sz;
+        }
+        reserveSmall(std::max(newSz, size_t(1) + maxSmallSize * 3 / 2));
+    } else {
+        sz = ml_.size_;
+        newSz = sz + delta;
+        // large 共享时 capacity() 返回 size，delta > 0 必然进入 reserve 完成 unshare
+        if (newSz > capacity()
+            || (category() == Category::isLarge && RefCounted::refs(ml_.data_) > 1)) {
+            reserve(std::max(newSz, 1 + ml_.capacity() * 3 / 2));
+        }
+    }
+    assert(capacity() >= newSz);
+    if (category() == Category::isLarge) {
+        RefCounted::resetHash(ml_.data_);
+    }
+    ml_.size_ = newSz;
+    ml_.data_[newSz] = '\0';
+    return ml_.data_ + sz;
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::shrink(size_t delta)
+{
+    switch (category()) {
+    case Category::isSmall:
+        setSmallSize(smallSize() - delta);
+        break;
+    case Category::isMedium:
+        ml_.size_ -= delta;
+        ml_.data_[ml_.size_] = '\0';
+        break;
+    case Category::isLarge:
+        assert(ml_.size_ >= delta);
+        if (RefCounted::refs(ml_.data_) > 1) {
+            // 不能在共享的缓冲区上写 '\0'，按新长度构造一份自己的
+            *this = BasicWnstring(ml_.data_, ml_.size_ - delta);
+        } else {
+            RefCounted::resetHash(ml_.data_);
+            ml_.size_ -= delta;
+            ml_.data_[ml_.size_] = '\0';
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy>& BasicWnstring<RefPolicy>::append(const char* const s, size_t n)
+{
+    if (n == 0) {
+        return *this;
+    }
+    // s 可能指向自身，扩容后原地址失效，记下偏移量
+    const char* const oldData = c_str();
+    auto const oldSize = size();
+    const bool aliased = s >= oldData && s < oldData + oldSize;
+    auto const offset = s - oldData;
+    char* const pos = expandNoinit(n);
+    memcpy(pos, aliased ? c_str() + offset : s, n);
+    return *this;
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::push_back(char c)
+{
+    *expandNoinit(1) = c;
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::resize(size_t n, char c)
+{
+    auto const size = this->size();
+    if (n <= size) {
+        shrink(size - n);
+    } else {
+        memset(expandNoinit(n - size), c, n - size);
+    }
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::pop_back()
+{
+    assert(!empty());
+    shrink(1);
+}
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::clear()
+{
+    resize(0);
+}
+
+// 以下查找的 pos 语义与 std::string 一致
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::find(const char* const s, size_t pos, size_t n) const
+{
+    auto const size = this->size();
+    if (pos > size) {
+        return npos;
+    }
+    auto const r = detail::searchForward(c_str() + pos, size - pos, s, n);
+    return r == detail::kNotFound ? npos : r + pos;
+}
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::rfind(const char* const s, size_t pos, size_t n) const
+{
+    auto const size = this->size();
+    if (n > size) {
+        return npos;
     }
-}
\ No newline at end of file
+    // 匹配起点不超过 pos，即只在 [0, pos + n) 内查找
+    pos = std::min(pos, size - n);
+    auto const r = detail::searchBackward(c_str(), pos + n, s, n);
+    return r == detail::kNotFound ? npos : r;
+}
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::find_first_of(const char* const s, size_t pos, size_t n) const
+{
+    auto const size = this->size();
+    if (pos >= size) {
+        return npos;
+    }
+    auto const r = detail::searchFirstOf(c_str() + pos, size - pos, s, n);
+    return r == detail::kNotFound ? npos : r + pos;
+}
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::count(const char* const s, size_t n) const
+{
+    return detail::countOccurrences(c_str(), size(), s, n);
+}
+
+// small string 的 24 字节可以直接按字比较：长度相同时末字节(长度标记)必然相同，
+// 只需屏蔽掉 '\0' 之后未定义的字节
+static bool smallEqual(const char* a, const char* b, size_t size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (size_t off = 0; off < size; off += sizeof(uint64_t)) {
+        uint64_t x, y;
+        memcpy(&x, a + off, sizeof x);
+        memcpy(&y, b + off, sizeof y);
+        uint64_t diff = x ^ y;
+        size_t rest = size - off;
+        if (rest < sizeof(uint64_t)) {
+            diff &= (uint64_t(1) << (rest * 8)) - 1;
+        }
+        if (diff != 0) {
+            return false;
+        }
+    }
+    return true;
+#else
+    return memcmp(a, b, size) == 0;
+#endif
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::operator==(const BasicWnstring& str) const
+{
+    auto const size = this->size();
+    if (size != str.size()) {
+        return false;
+    }
+    auto const c = category();
+    if (c == Category::isSmall && str.category() == Category::isSmall) {
+        return smallEqual(small_, str.small_, size);
+    }
+    if (c == Category::isLarge && str.category() == Category::isLarge) {
+        if (ml_.data_ == str.ml_.data_) {
+            return true;
+        }
+        auto const h1 = RefCounted::fromData(ml_.data_)->hash_.load(std::memory_order_relaxed);
+        auto const h2 = RefCounted::fromData(str.ml_.data_)->hash_.load(std::memory_order_relaxed);
+        if (h1 != 0 && h2 != 0 && h1 != h2) {
+            return false;
+        }
+    }
+    // glibc 的 memcmp 本身按 CPU 选择 SSE2/AVX2 实现
+    return memcmp(c_str(), str.c_str(), size) == 0;
+}
+
+static int compareBytes(const char* a, size_t n1, const char* b, size_t n2)
+{
+    int r = memcmp(a, b, std::min(n1, n2));
+    if (r != 0) {
+        return r;
+    }
+    return n1 < n2 ? -1 : (n1 > n2 ? 1 : 0);
+}
+
+template <typename RefPolicy>
+int BasicWnstring<RefPolicy>::compare(const BasicWnstring& str) const
+{
+    if (category() == Category::isLarge && str.category() == Category::isLarge && ml_.data_ == str.ml_.data_) {
+        return 0;
+    }
+    return compareBytes(c_str(), size(), str.c_str(), str.size());
+}
+template <typename RefPolicy>
+int BasicWnstring<RefPolicy>::compare(const char* const s) const
+{
+    return compareBytes(c_str(), size(), s, strlen(s));
+}
+
+template <typename RefPolicy>
+size_t BasicWnstring<RefPolicy>::hash() const
+{
+    if (category() != Category::isLarge) {
+        return detail::hashBytes(c_str(), size());
+    }
+    auto const rc = RefCounted::fromData(ml_.data_);
+    auto h = rc->hash_.load(std::memory_order_relaxed);
+    if (h == 0) {
+        h = detail::hashBytes(ml_.data_, ml_.size_);
+        rc->hash_.store(h, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::fromInt(long long v)
+{
+    BasicWnstring result;
+    result.setSmallSize(detail::formatSigned(result.small_, v));
+    return result;
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::fromUnsigned(unsigned long long v)
+{
+    BasicWnstring result;
+    result.setSmallSize(detail::formatUnsigned(result.small_, v));
+    return result;
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::fromDouble(double v)
+{
+    BasicWnstring result;
+    auto r = std::to_chars(result.small_, result.small_ + maxSmallSize, v);
+    if (r.ec == std::errc()) {
+        result.setSmallSize(r.ptr - result.small_);
+        return result;
+    }
+    // 最长的情形如 "-2.2250738585072014e-308" 是 24 个字符
+    char buf[32];
+    r = std::to_chars(buf, buf + sizeof buf, v);
+    assert(r.ec == std::errc());
+    return BasicWnstring(buf, r.ptr - buf);
+}
+
+static bool parseFailed(WnstringParseError* error, WnstringParseError reason)
+{
+    if (error) {
+        *error = reason;
+    }
+    return false;
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::toInt(int64_t* out, WnstringParseError* error) const
+{
+    const char* s = c_str();
+    const size_t n = size();
+    const bool negative = n > 0 && s[0] == '-';
+    const size_t sign = (n > 0 && (s[0] == '-' || s[0] == '+')) ? 1 : 0;
+    uint64_t magnitude;
+    bool overflow;
+    const size_t digits = detail::parseUnsigned(s + sign, n - sign, &magnitude, &overflow);
+    if (digits == 0 || sign + digits != n) {
+        return parseFailed(error, WnstringParseError::kInvalid);
+    }
+    const uint64_t limit = negative ? static_cast<uint64_t>(INT64_MAX) + 1 : static_cast<uint64_t>(INT64_MAX);
+    if (overflow || magnitude > limit) {
+        return parseFailed(error, WnstringParseError::kOverflow);
+    }
+    *out = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    if (error) {
+        *error = WnstringParseError::kNone;
+    }
+    return true;
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::toDouble(double* out, WnstringParseError* error) const
+{
+    const char* s = c_str();
+    const size_t n = size();
+    // from_chars 不接受前导 '+'
+    const size_t skip = (n > 1 && s[0] == '+' && s[1] != '-') ? 1 : 0;
+    double value;
+    auto r = std::from_chars(s + skip, s + n, value);
+    if (r.ec == std::errc::invalid_argument || r.ptr != s + n || n == 0) {
+        return parseFailed(error, WnstringParseError::kInvalid);
+    }
+    if (r.ec == std::errc::result_out_of_range) {
+        return parseFailed(error, WnstringParseError::kOverflow);
+    }
+    *out = value;
+    if (error) {
+        *error = WnstringParseError::kNone;
+    }
+    return true;
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::validUtf8() const
+{
+    return detail::validateUtf8(c_str(), size());
+}
+
+template <typename RefPolicy>
+void BasicWnstring<RefPolicy>::convertAsciiCase(char first)
+{
+    const size_t pos = detail::findAsciiLetter(c_str(), size(), first);
+    if (pos == detail::kNotFound) {
+        return;
+    }
+    // 确实要写时才取可写指针：large string 在这里 unshare 并清除缓存的哈希
+    char* data = &(*this)[0];
+    detail::flipAsciiCase(data + pos, size() - pos, first);
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::toUtf16(std::u16string* out) const
+{
+    // 每个 UTF-8 字节最多产生一个 UTF-16 单元
+    std::u16string result(size(), u'\0');
+    const size_t n = detail::utf8ToUtf16(c_str(), size(), &result[0]);
+    if (n == detail::kNotFound) {
+        return false;
+    }
+    result.resize(n);
+    out->swap(result);
+    return true;
+}
+
+template <typename RefPolicy>
+bool BasicWnstring<RefPolicy>::fromUtf16(const char16_t* s, size_t n, BasicWnstring* out)
+{
+    // 每个 UTF-16 单元最多 3 个 UTF-8 字节，先按上限扩出未初始化空间，写完再截到实际长度
+    BasicWnstring result;
+    const size_t len = detail::utf16ToUtf8(s, n, n > 0 ? result.expandNoinit(n * 3) : result.small_);
+    if (len == detail::kNotFound) {
+        return false;
+    }
+    result.resize(len);
+    *out = std::move(result);
+    return true;
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::makeLarge(const char* data, size_t size)
+{
+    BasicWnstring result;
+    result.initLarge(data, size);
+    return result;
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstring<RefPolicy>::fromShared(char* data, size_t size, size_t capacity, bool arena)
+{
+    BasicWnstring result;
+    RefCounted::incrementRefs(data);
+    result.ml_.data_ = data;
+    result.ml_.size_ = size;
+    result.ml_.setCapacity(capacity, Category::isLarge, arena);
+    return result;
+}
+
+template <typename RefPolicy>
+BasicWnstringView<RefPolicy> BasicWnstring<RefPolicy>::substr(size_t pos, size_t n) const
+{
+    if (category() == Category::isLarge) {
+        return BasicWnstringView<RefPolicy>(*this).substr(pos, n);
+    }
+    // small/medium 的数据在对象内或随修改重新分配，借用会随源的修改失效：
+    // 把片段复制进一个 RefCounted 块，视图的生命期与大小类别无关
+    assert(pos <= size());
+    pos = std::min(pos, size());
+    return BasicWnstringView<RefPolicy>(makeLarge(c_str() + pos, std::min(n, size() - pos)));
+}
+
+template <typename RefPolicy>
+BasicWnstringView<RefPolicy>::BasicWnstringView(const BasicWnstring<RefPolicy>& s) noexcept
+    : data_(s.c_str())
+    , size_(s.size())
+    , owner_(nullptr)
+    , ownerSize_(0)
+    , ownerCapacity_(0)
+    , ownerArena_(false)
+{
+    if (s.category() == Category::isLarge) {
+        owner_ = s.ml_.data_;
+        ownerSize_ = s.ml_.size_;
+        ownerCapacity_ = s.ml_.capacity();
+        ownerArena_ = s.ml_.arena();
+        RefCounted::incrementRefs(owner_);
+    }
+}
+
+template <typename RefPolicy>
+BasicWnstring<RefPolicy> BasicWnstringView<RefPolicy>::str() const
+{
+    // 只有完整覆盖时才能共享：结尾的 '\0' 和 RefCounted 中缓存的哈希都对应整个串
+    if (owner_ && data_ == owner_ && size_ == ownerSize_) {
+        return BasicWnstring<RefPolicy>::fromShared(owner_, size_, ownerCapacity_, ownerArena_);
+    }
+    return BasicWnstring<RefPolicy>(data_, size_);
+}
+
+template class BasicWnstring<AtomicRefs>;
+template class BasicWnstring<LocalRefs>;
+template class BasicWnstringView<AtomicRefs>;
+template class BasicWnstringView<LocalRefs>;
@@ -3,8 +3,17 @@
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#if __has_include(<compare>)
+#include <compare>
+#endif
+
+#include "wnstringalloc.h"
 
 // small strings（SSO）时，使用 union 中的 Char small_存储字符串，即对象本身的栈空间。
 
@@ -14,31 +23,12 @@
 // ml*.data_指向 RefCounted.data，ml*.size_与 ml.capacity_的含义不变。
 
 constexpr static uint8_t categoryExtractMask = 0xC0; // 11000000
+// 缓冲区来自 WnstringArena。small string 的最后一个字节最大为 maxSmallSize(23)，不会误带此标记
+constexpr static uint8_t arenaFlag = 0x20; // 00100000
 constexpr static size_t kCategoryShift = (sizeof(size_t) - 1) * 8;
-constexpr static size_t capacityExtractMask = ~(static_cast<size_t>(categoryExtractMask) << kCategoryShift);
+constexpr static size_t capacityExtractMask = ~(static_cast<size_t>(categoryExtractMask | arenaFlag) << kCategoryShift);
 constexpr static bool WNSTRING_DISABLE_SSO = false;
 
-inline void* checkedRealloc(void* ptr, size_t size)
-{
-    void* p = realloc(ptr, size);
-    return p;
-}
-inline void* smartRealloc(void* p, const size_t currentSize, const size_t currentCapacity, const size_t newCapacity)
-{
-    assert(p);
-    assert(currentSize <= currentCapacity && currentCapacity < newCapacity);
-    auto const slack = currentCapacity - currentSize;
-    if (slack * 2 > currentSize) {
-        // Too much slack, malloc-copy-free cycle:
-        auto const result = new char[newCapacity];
-        std::memcpy(result, p, currentSize);
-        delete (char*)p;
-        return result;
-    }
-    // If there's not too much slack, we realloc in hope of coalescing
-    return checkedRealloc(p, newCapacity);
-}
-
 typedef uint8_t category_type;
 enum class Category : category_type {
     // 容量23
@@ -49,38 +39,83 @@ enum class Category : category_type {
     isLarge = 0x40, // 01000000
 };
 
-struct RefCounted {
-    std::atomic<size_t> refCount_; // 共享字符串的引用计数
+// 引用计数的线程策略。
+// AtomicRefs: 计数用原子 RMW，large string 可以在线程间共享，是 Wnstring 的默认策略。
+// LocalRefs: 计数是普通整数，省掉 lock 前缀指令，只能用于不出线程的字符串(LocalWnstring)。
+// 跨线程时先显式转换成 Wnstring，见 BasicWnstring 的转换构造函数
+struct AtomicRefs {
+    typedef std::atomic<size_t> Counter;
+    static size_t load(const Counter& c) { return c.load(std::memory_order_acquire); }
+    static void increment(Counter& c) { c.fetch_add(1, std::memory_order_acq_rel); }
+    // 返回减之前的值
+    static size_t decrement(Counter& c) { return c.fetch_sub(1, std::memory_order_acq_rel); }
+};
+
+struct LocalRefs {
+    typedef size_t Counter;
+    static size_t load(const Counter& c) { return c; }
+    static void increment(Counter& c) { ++c; }
+    static size_t decrement(Counter& c) { return c--; }
+};
+// 转换策略时块原地换计数(BasicRefCounted::adopt)，要求两种计数布局一致
+static_assert(sizeof(AtomicRefs::Counter) == sizeof(LocalRefs::Counter)
+        && alignof(AtomicRefs::Counter) == alignof(LocalRefs::Counter),
+    "refcount layouts must match");
+
+template <typename RefPolicy>
+struct BasicRefCounted {
+    typedef typename RefPolicy::Counter Counter;
+
+    Counter refCount_; // 共享字符串的引用计数
+    // 内容的哈希值，0 表示尚未计算。只有唯一持有者会修改内容，修改时清零；
+    // 共享期间内容不变，各持有者并发写入的是同一个值，relaxed 即可
+    std::atomic<size_t> hash_;
     char data_[1]; // flexible array. 存放字符串。
 
     // 获得data_的数据偏移，也是refCount_的首地址到data_首地址的长度
     constexpr static size_t getDataOffset()
     {
-        return offsetof(RefCounted, data_);
+        return offsetof(BasicRefCounted, data_);
     }
-    // 创建一个RefCounted
-    static RefCounted* create(size_t* size)
+    // 创建一个RefCounted。*size 返回实际容量(分配器可能给得更多)，*arena 返回是否来自 arena
+    static BasicRefCounted* create(size_t* size, bool* arena)
     {
-        const size_t allocSize = getDataOffset() + (*size + 1) * sizeof(char);
-        auto result = reinterpret_cast<RefCounted*>(new char[allocSize]);
-        result->refCount_.store(1, std::memory_order_release);
-        *size = (allocSize - getDataOffset()) - 1;
+        size_t allocSize = getDataOffset() + (*size + 1) * sizeof(char);
+        auto result = static_cast<BasicRefCounted*>(detail::stringAllocate(&allocSize, arena));
+        new (&result->refCount_) Counter(1);
+        result->hash_.store(0, std::memory_order_relaxed);
+        *size = (allocSize - getDataOffset()) / sizeof(char) - 1;
         return result;
     }
-    static RefCounted* create(const char* data, size_t* size)
+    static BasicRefCounted* create(const char* data, size_t* size, bool* arena)
     {
         const size_t effectiveSize = *size;
-        auto result = create(size);
+        auto result = create(size, arena);
 
         memcpy(result->data_, data, effectiveSize);
         return result;
     }
+    // 唯一持有者扩容：对整个 RefCounted 块做 stringReallocate，尽量原地扩展
+    static BasicRefCounted* reallocate(char* data, size_t currentSize, size_t currentCapacity, size_t* newCapacity,
+        bool* arena)
+    {
+        assert(*newCapacity > currentCapacity);
+        size_t allocNewCapacity = getDataOffset() + (*newCapacity + 1) * sizeof(char);
+        auto const dis = fromData(data);
+        assert(RefPolicy::load(dis->refCount_) == 1);
+        auto result = static_cast<BasicRefCounted*>(detail::stringReallocate(dis,
+            getDataOffset() + (currentSize + 1) * sizeof(char),
+            getDataOffset() + (currentCapacity + 1) * sizeof(char),
+            &allocNewCapacity, arena));
+        *newCapacity = (allocNewCapacity - getDataOffset()) / sizeof(char) - 1;
+        return result;
+    }
     // 从data获取RefCounted*
     // 转换不同类型结构体的指针并做运算，这里的做法是 ：
     // char* -> void* -> unsigned char* -> 与size_t做减法 -> void * -> RefCounted*
-    static RefCounted* fromData(char* p)
+    static BasicRefCounted* fromData(char* p)
     {
-        return static_cast<RefCounted*>(static_cast<void*>(
+        return static_cast<BasicRefCounted*>(static_cast<void*>(
             static_cast<unsigned char*>(static_cast<void*>(p)) - getDataOffset()));
     }
     // static RefCounted * fromData(Char * p) {
@@ -99,21 +134,31 @@ struct RefCounted {
     // 获得引用数量
     static size_t refs(char* p)
     {
-        return fromData(p)->refCount_.load(std::memory_order_acquire);
+        return RefPolicy::load(fromData(p)->refCount_);
+    }
+    static void resetHash(char* p)
+    {
+        fromData(p)->hash_.store(0, std::memory_order_relaxed);
     }
     // 增加一个引用
     static void incrementRefs(char* p)
     {
-        fromData(p)->refCount_.fetch_add(1, std::memory_order_acq_rel);
+        RefPolicy::increment(fromData(p)->refCount_);
+    }
+    // 唯一持有者把块转交给另一种线程策略：两种计数的布局相同，在原位置重建计数即可，
+    // 数据和缓存的哈希都保留
+    static void adopt(char* p)
+    {
+        new (&fromData(p)->refCount_) Counter(1);
     }
-    // 减少一个引用
-    static void decrementRefs(char* p)
+    // 减少一个引用，最后一个引用负责释放。capacity 和 arena 来自持有者的 MediumLarge
+    static void decrementRefs(char* p, size_t capacity, bool arena)
     {
         auto const dis = fromData(p);
-        size_t oldcnt = dis->refCount_.fetch_sub(1, std::memory_order_acq_rel);
+        size_t oldcnt = RefPolicy::decrement(dis->refCount_);
         assert(oldcnt > 0);
         if (oldcnt == 1) {
-            delete dis;
+            detail::stringDeallocate(dis, getDataOffset() + (capacity + 1) * sizeof(char), arena);
         }
     }
 };
@@ -123,11 +168,15 @@ struct MediumLarge {
     size_t size_; // 字符串长度
     size_t capacity_; // 字符串容量
 
-    // 同时设置容量和字符串类型
-    void setCapacity(size_t cap, Category cat)
+    // 同时设置容量、字符串类型和缓冲区来源
+    void setCapacity(size_t cap, Category cat, bool arena)
+    {
+        // 用最高字节存储字符串类型和 arena 标记，其余位存容量
+        capacity_ = cap | (static_cast<size_t>(static_cast<category_type>(cat) | (arena ? arenaFlag : 0)) << kCategoryShift);
+    }
+    bool arena() const
     {
-        // 用最高字节存储字符串类型，低7字节存容量
-        capacity_ = cap | (static_cast<size_t>(cat) << kCategoryShift);
+        return (capacity_ >> kCategoryShift) & arenaFlag;
     }
     // 取字符串容量
     size_t capacity() const
@@ -139,11 +188,36 @@ constexpr static size_t lastChar = sizeof(MediumLarge) - 1;
 constexpr static uint8_t maxSmallSize = sizeof(MediumLarge) - 1;
 constexpr static uint8_t maxMediumSize = 0xFF; // 11111111(255)
 
-class Wnstring {
+template <typename RefPolicy>
+class BasicWnstringView;
+
+// toInt/toDouble 失败的原因
+enum class WnstringParseError {
+    kNone,
+    kInvalid, // 空串、多余字符或没有数字
+    kOverflow, // 超出目标类型的范围
+};
+
+template <typename RefPolicy>
+class BasicWnstring {
 public:
-    Wnstring(const char* const data, const size_t size, bool disableSSO = WNSTRING_DISABLE_SSO);
-    Wnstring(const Wnstring& rhs);
-    ~Wnstring();
+    typedef BasicRefCounted<RefPolicy> RefCounted;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    BasicWnstring() noexcept { setSmallSize(0); }
+    BasicWnstring(const char* const data, const size_t size, bool disableSSO = WNSTRING_DISABLE_SSO);
+    BasicWnstring(const BasicWnstring& rhs);
+    // 移动只搬走 ml_ 这 24 字节，原对象置为空的 small string。
+    // noexcept 保证 std::vector 等容器扩容时走移动而不是拷贝
+    BasicWnstring(BasicWnstring&& goner) noexcept;
+    // 不同线程策略之间只能显式转换，例如 Wnstring(std::move(local)) 交给其他线程。
+    // 拷贝总是复制内容，两种计数不能作用在同一块上；移动时 small/medium 直接搬走，
+    // 唯一持有的 large 块原地换成本策略的计数，都不复制
+    template <typename OtherPolicy>
+    explicit BasicWnstring(const BasicWnstring<OtherPolicy>& rhs): BasicWnstring(rhs.c_str(), rhs.size()) {}
+    template <typename OtherPolicy>
+    explicit BasicWnstring(BasicWnstring<OtherPolicy>&& goner);
+    ~BasicWnstring();
 
     size_t capacity() const;
     size_t size() const;
@@ -154,18 +228,96 @@ public:
     const char& operator[](size_t pos) const;
     bool empty() const;
 
-    Wnstring& operator=(const Wnstring& str); // fix
-    Wnstring& operator=(const char* const s); // fix
-    bool operator==(const Wnstring& str) const; // fix
-    Wnstring operator+(const Wnstring& rhs); // fix
+    BasicWnstring& operator=(const BasicWnstring& str);
+    BasicWnstring& operator=(BasicWnstring&& goner) noexcept;
+    BasicWnstring& operator=(const char* const s);
+    BasicWnstring operator+(const BasicWnstring& rhs) const;
+
+    // 先比长度和类型；共享同一 RefCounted 的 large string 直接判等，
+    // 两边都有缓存的哈希且不同则直接判不等
+    bool operator==(const BasicWnstring& str) const;
+    bool operator!=(const BasicWnstring& str) const { return !(*this == str); }
+    // 字典序，返回值含义同 memcmp
+    int compare(const BasicWnstring& str) const;
+    int compare(const char* const s) const;
+#if defined(__cpp_lib_three_way_comparison)
+    std::strong_ordering operator<=>(const BasicWnstring& str) const { return compare(str) <=> 0; }
+#else
+    bool operator<(const BasicWnstring& str) const { return compare(str) < 0; }
+    bool operator<=(const BasicWnstring& str) const { return compare(str) <= 0; }
+    bool operator>(const BasicWnstring& str) const { return compare(str) > 0; }
+    bool operator>=(const BasicWnstring& str) const { return compare(str) >= 0; }
+#endif
+    // large string 的哈希缓存在共享的 RefCounted 中，重复查表不必重新扫描内容。
+    // 注意：通过 operator[] 取得的引用在之后的写入不会再清除缓存
+    size_t hash() const;
+    // 缓冲区是否来自 WnstringArena(small string 总是 false)。要比 arena 活得久的拷贝需先检查它
+    bool arena() const;
+
+    // 整数直接写进 SSO 缓冲(最多 20 个字符)，不经过临时字符串
+    static BasicWnstring fromInt(long long v);
+    static BasicWnstring fromUnsigned(unsigned long long v);
+    // 能往返的最短表示(std::to_chars)。不超过 23 个字符时同样直接写进 SSO 缓冲
+    static BasicWnstring fromDouble(double v);
+    // 整个字符串必须恰好是一个数，不跳过空白。toInt 接受可选的 '+'/'-' 和十进制数字，
+    // 每 8 位数字用 SWAR 一次解析；toDouble 接受 strtod 的十进制与科学计数格式(不含十六进制)。
+    // 失败时返回 false，*out 不变，error 非空时给出原因
+    bool toInt(int64_t* out, WnstringParseError* error = nullptr) const;
+    bool toDouble(double* out, WnstringParseError* error = nullptr) const;
+
+    // 合法的 UTF-8：不含截断的序列、超长编码、代理区和超过 U+10FFFF 的码点。AVX2 下每 32 字节无分支查表校验
+    bool validUtf8() const;
+    // 只转换 ASCII 字母，其余字节(包括 UTF-8 多字节序列)不变。
+    // 先找第一个需要改的字节，没有就直接返回：共享的 large string 不会 unshare，缓存的哈希也保留
+    void toLowerAscii() { convertAsciiCase('A'); }
+    void toUpperAscii() { convertAsciiCase('a'); }
+    // UTF-8 与 UTF-16 互转。输入不合法(含不成对的代理)时返回 false，*out 不变
+    bool toUtf16(std::u16string* out) const;
+    static bool fromUtf16(const char16_t* s, size_t n, BasicWnstring* out);
+
+    // 不论长短都建成 large string，之后的拷贝共享同一个 RefCounted 块。供驻留池等需要共享身份的场合使用
+    static BasicWnstring makeLarge(const char* data, size_t size);
+
+    // 返回的视图总是持有 RefCounted 引用，不依赖源的生命期：large string 的子串与原串共享，不复制；
+    // small/medium 的片段复制到新块中。只想借用时用 WnstringView(s).substr()
+    BasicWnstringView<RefPolicy> substr(size_t pos = 0, size_t n = npos) const;
 
-    void clear(); // fix
-    size_t find(const char* const s, size_t pos = 0) const; // fix BM
-    size_t find(const Wnstring& str, size_t pos = 0) const; // fix BM
-    void pop_back(); // fix
-    int compare(const Wnstring& str) const; // fix
+    // 增长按 1.5 倍预留容量，medium/large 通过 stringReallocate 尽量原地扩展
+    void reserve(size_t minCapacity);
+    BasicWnstring& append(const char* const s, size_t n);
+    BasicWnstring& append(const char* const s) { return append(s, strlen(s)); }
+    BasicWnstring& append(const BasicWnstring& str) { return append(str.c_str(), str.size()); }
+    BasicWnstring& assign(const char* const s, size_t n);
+    void push_back(char c);
+    void resize(size_t n, char c = '\0');
+
+    void clear();
+    void pop_back();
+
+    // 查找内核见 wnstringsearch.h：短 needle 用 SIMD 首尾字节过滤，长 needle 用 Horspool
+    size_t find(const char* const s, size_t pos = 0) const { return find(s, pos, strlen(s)); }
+    size_t find(const char* const s, size_t pos, size_t n) const;
+    size_t find(const BasicWnstring& str, size_t pos = 0) const { return find(str.c_str(), pos, str.size()); }
+    size_t find(char c, size_t pos = 0) const { return find(&c, pos, 1); }
+    size_t rfind(const char* const s, size_t pos = npos) const { return rfind(s, pos, strlen(s)); }
+    size_t rfind(const char* const s, size_t pos, size_t n) const;
+    size_t rfind(const BasicWnstring& str, size_t pos = npos) const { return rfind(str.c_str(), pos, str.size()); }
+    size_t find_first_of(const char* const s, size_t pos = 0) const { return find_first_of(s, pos, strlen(s)); }
+    size_t find_first_of(const char* const s, size_t pos, size_t n) const;
+    size_t find_first_of(const BasicWnstring& str, size_t pos = 0) const
+    {
+        return find_first_of(str.c_str(), pos, str.size());
+    }
+    // 子串不重叠出现的次数
+    size_t count(const char* const s) const { return count(s, strlen(s)); }
+    size_t count(const char* const s, size_t n) const;
+    size_t count(const BasicWnstring& str) const { return count(str.c_str(), str.size()); }
 
 private:
+    template <typename>
+    friend class BasicWnstring;
+    friend class BasicWnstringView<RefPolicy>;
+
     union {
         uint8_t bytes_[sizeof(MediumLarge)]; // 配合 lastChar 更加方便的取该结构最后一个字节（字符串种类）
         char small_[sizeof(MediumLarge) / sizeof(char)];
@@ -173,17 +325,64 @@ private:
     };
 
     void setSmallSize(size_t s);
+    size_t smallSize() const
+    {
+        assert(category() == Category::isSmall);
+        return maxSmallSize - static_cast<size_t>(bytes_[lastChar]);
+    }
     Category category() const;
 
-    void initSmall(const char* const data, const size_t size);
+    // 按字读取源数据，可能越过末尾，见定义处
+    __attribute__((no_sanitize("address"))) void initSmall(const char* const data, const size_t size);
     void initMedium(const char* const data, const size_t size);
     void initLarge(const char* const data, const size_t size);
-    void copySmall(const Wnstring& rhs);
-    void copyMedium(const Wnstring& rhs);
-    void copyLarge(const Wnstring& rhs);
+    void copySmall(const BasicWnstring& rhs);
+    void copyMedium(const BasicWnstring& rhs);
+    void copyLarge(const BasicWnstring& rhs);
     void destroyMediumLarge();
     char* mutableDataLarge();
+    void convertAsciiCase(char first);
     void unshare(size_t minCapacity = 0);
+
+    void reserveSmall(size_t minCapacity);
+    void reserveMedium(size_t minCapacity);
+    void reserveLarge(size_t minCapacity);
+    // 尾部扩出 delta 个未初始化字节，返回其起始位置
+    char* expandNoinit(size_t delta);
+    void shrink(size_t delta);
+
+    // 引用一个已有的 RefCounted 块
+    static BasicWnstring fromShared(char* data, size_t size, size_t capacity, bool arena);
+};
+
+template <typename RefPolicy>
+template <typename OtherPolicy>
+BasicWnstring<RefPolicy>::BasicWnstring(BasicWnstring<OtherPolicy>&& goner)
+{
+    setSmallSize(0);
+    if (goner.category() == Category::isLarge) {
+        if (BasicRefCounted<OtherPolicy>::refs(goner.ml_.data_) > 1) {
+            // 块还被其他同策略的对象共享，只能复制
+            *this = BasicWnstring(goner.ml_.data_, goner.ml_.size_);
+            return;
+        }
+        RefCounted::adopt(goner.ml_.data_);
+    }
+    ml_ = goner.ml_;
+    goner.setSmallSize(0);
+}
+
+// 默认的线程安全版本；LocalWnstring 只能在单个线程内使用
+typedef BasicWnstring<AtomicRefs> Wnstring;
+typedef BasicWnstring<LocalRefs> LocalWnstring;
+
+namespace std {
+template <typename RefPolicy>
+struct hash<BasicWnstring<RefPolicy>> {
+    size_t operator()(const BasicWnstring<RefPolicy>& s) const noexcept { return s.hash(); }
 };
+} // namespace std
+
+#include "wnstringview.h"
 
-#endif // WNSTRING_H
\ No newline at end of file
+#endif // WNSTRING_H
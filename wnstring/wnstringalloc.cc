@@ -0,0 +1,276 @@
+#include "wnstringalloc.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+void* mallocAllocate(size_t size)
+{
+    void* p = malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* mallocReallocate(void* p, size_t size)
+{
+    void* q = realloc(p, size);
+    if (!q) {
+        throw std::bad_alloc();
+    }
+    return q;
+}
+void mallocDeallocate(void* p, size_t)
+{
+    free(p);
+}
+
+WnstringAllocator g_allocator = { mallocAllocate, mallocReallocate, mallocDeallocate };
+
+thread_local WnstringArena* t_arena = nullptr;
+
+// 尺寸级别：<= 128 按 16 字节递增，之后到 kMaxCachedSize 按 64 字节递增
+constexpr size_t kNumClasses = 8 + (detail::kMaxCachedSize - 128) / 64;
+
+inline size_t classSize(size_t index)
+{
+    return index < 8 ? (index + 1) * 16 : 128 + (index - 7) * 64;
+}
+// 不小于 size 的最小级别
+inline size_t classIndex(size_t size)
+{
+    assert(size > 0 && size <= detail::kMaxCachedSize);
+    return size <= 128 ? (size + 15) / 16 - 1 : 8 + (size - 129) / 64;
+}
+
+// 每个线程一份，不加锁。每级最多缓存 kMaxPerClass 块，多出的交还全局分配器
+class ThreadCache {
+public:
+    ThreadCache(): disabled_(false)
+    {
+        for (size_t i = 0; i < kNumClasses; ++i) {
+            heads_[i] = nullptr;
+            counts_[i] = 0;
+        }
+    }
+    ~ThreadCache()
+    {
+        for (size_t i = 0; i < kNumClasses; ++i) {
+            while (heads_[i]) {
+                FreeBlock* next = heads_[i]->next_;
+                g_allocator.deallocate(heads_[i], classSize(i));
+                heads_[i] = next;
+            }
+        }
+        // 之后析构的其他线程局部对象里若还有 Wnstring，直接走全局分配器
+        disabled_ = true;
+    }
+
+    void* allocate(size_t* size)
+    {
+        if (disabled_ || *size > detail::kMaxCachedSize) {
+            return g_allocator.allocate(*size);
+        }
+        size_t index = classIndex(*size);
+        *size = classSize(index);
+        FreeBlock* b = heads_[index];
+        if (b) {
+            heads_[index] = b->next_;
+            --counts_[index];
+            return b;
+        }
+        return g_allocator.allocate(*size);
+    }
+
+    void deallocate(void* p, size_t size)
+    {
+        if (disabled_ || size > detail::kMaxCachedSize || size < classSize(0)) {
+            g_allocator.deallocate(p, size);
+            return;
+        }
+        // 放入不大于 size 的最大级别，块的实际大小只会更大
+        size_t index = classIndex(size);
+        if (classSize(index) > size) {
+            --index;
+        }
+        if (counts_[index] >= kMaxPerClass) {
+            g_allocator.deallocate(p, size);
+            return;
+        }
+        FreeBlock* b = static_cast<FreeBlock*>(p);
+        b->next_ = heads_[index];
+        heads_[index] = b;
+        ++counts_[index];
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next_;
+    };
+    static const int kMaxPerClass = 64;
+
+    FreeBlock* heads_[kNumClasses];
+    int counts_[kNumClasses];
+    bool disabled_;
+};
+
+thread_local ThreadCache t_cache;
+
+inline size_t alignUp(size_t n)
+{
+    return (n + 15) & ~static_cast<size_t>(15);
+}
+
+} // namespace
+
+void setWnstringAllocator(const WnstringAllocator& allocator)
+{
+    g_allocator = allocator;
+}
+
+namespace detail {
+
+void* stringAllocate(size_t* size, bool* arena)
+{
+    if (t_arena) {
+        *arena = true;
+        return t_arena->allocate(size);
+    }
+    *arena = false;
+    return t_cache.allocate(size);
+}
+
+void stringDeallocate(void* p, size_t size, bool arena)
+{
+    if (arena) {
+        if (t_arena) {
+            t_arena->deallocate(p);
+        }
+        return;
+    }
+    t_cache.deallocate(p, size);
+}
+
+void* stringReallocate(void* p, size_t currentSize, size_t currentCapacity, size_t* newCapacity, bool* arena)
+{
+    assert(p);
+    assert(currentSize <= currentCapacity && currentCapacity < *newCapacity);
+    if (*arena) {
+        // 块恰好是当前 arena 最近一次分配时可以原地扩展
+        if (t_arena && t_arena->tryExtend(p, newCapacity)) {
+            return p;
+        }
+    } else if (*newCapacity > kMaxCachedSize) {
+        // 与原 smartRealloc 相同的取舍：slack 过多时 realloc 会复制整个容量，不如自己复制有效部分
+        auto const slack = currentCapacity - currentSize;
+        if (slack * 2 <= currentSize) {
+            return g_allocator.reallocate(p, *newCapacity);
+        }
+    }
+    // 小块、arena 块和 slack 过多的情况：分配-复制-释放。
+    // 原本在堆上的串留在堆上，否则长寿的串在 Scope 内增长一次就会落进 arena
+    bool oldArena = *arena;
+    void* result = oldArena ? stringAllocate(newCapacity, arena) : t_cache.allocate(newCapacity);
+    memcpy(result, p, currentSize);
+    stringDeallocate(p, currentCapacity, oldArena);
+    return result;
+}
+
+} // namespace detail
+
+WnstringArena::WnstringArena(size_t blockSize)
+    : blockSize_(blockSize)
+    , blocks_(nullptr)
+    , cur_(nullptr)
+    , end_(nullptr)
+    , last_(nullptr)
+    , bytesAllocated_(0)
+{
+}
+
+WnstringArena::~WnstringArena()
+{
+    release();
+}
+
+void* WnstringArena::allocate(size_t* size)
+{
+    size_t n = alignUp(*size);
+    if (static_cast<size_t>(end_ - cur_) < n) {
+        // 大请求单独占一块，不浪费当前块剩余的空间
+        size_t payload = n > blockSize_ / 4 ? n : blockSize_;
+        size_t header = alignUp(sizeof(Block));
+        Block* b = static_cast<Block*>(g_allocator.allocate(header + payload));
+        b->size_ = header + payload;
+        b->next_ = blocks_;
+        blocks_ = b;
+        bytesAllocated_ += b->size_;
+        char* data = reinterpret_cast<char*>(b) + header;
+        if (payload != blockSize_ && cur_) {
+            last_ = nullptr;
+            *size = n;
+            return data;
+        }
+        cur_ = data;
+        end_ = data + payload;
+    }
+    last_ = cur_;
+    cur_ += n;
+    *size = n;
+    return last_;
+}
+
+bool WnstringArena::tryExtend(void* p, size_t* newSize)
+{
+    size_t n = alignUp(*newSize);
+    if (p != last_ || static_cast<size_t>(end_ - last_) < n) {
+        return false;
+    }
+    cur_ = last_ + n;
+    *newSize = n;
+    return true;
+}
+
+void WnstringArena::deallocate(void* p)
+{
+    if (p == last_) {
+        cur_ = last_;
+        last_ = nullptr;
+    }
+}
+
+void WnstringArena::release()
+{
+    while (blocks_) {
+        Block* next = blocks_->next_;
+        g_allocator.deallocate(blocks_, blocks_->size_);
+        blocks_ = next;
+    }
+    cur_ = end_ = last_ = nullptr;
+    bytesAllocated_ = 0;
+}
+
+WnstringArena::Scope::Scope(WnstringArena& arena)
+    : prev_(t_arena)
+{
+    t_arena = &arena;
+}
+
+WnstringArena::Scope::~Scope()
+{
+    t_arena = prev_;
+}
+
+WnstringArena::Suspend::Suspend()
+    : prev_(t_arena)
+{
+    t_arena = nullptr;
+}
+
+WnstringArena::Suspend::~Suspend()
+{
+    t_arena = prev_;
+}
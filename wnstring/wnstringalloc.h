@@ -0,0 +1,95 @@
+#ifndef WNSTRINGALLOC_H
+#define WNSTRINGALLOC_H
+
+#include <cstddef>
+
+// Wnstring 缓冲区(medium 的字符数组、large 的 RefCounted 块)的统一分配入口，分三层：
+//
+// 1. 全局钩子 WnstringAllocator，默认是 malloc/realloc/free，可在进程启动时替换成别的分配器。
+// 2. 线程局部的分级缓存：不超过 kMaxCachedSize 的块按尺寸级别取整，释放时挂回本线程的空闲链表，
+//    大量短命的 medium string 不再进出 malloc。
+// 3. WnstringArena：指针递增分配，整体释放。Scope 生效期间本线程新分配的缓冲区都来自 arena，
+//    用于请求级别的临时字符串；这些字符串必须在 arena 释放之前销毁。
+//    "新分配"包括容器内部做的拷贝：Scope 内插入 intern 池、WnstringMap 的 key 等也会落进 arena。
+//    比 arena 活得久的结构在分配前用 Suspend 暂停 arena(intern 池、WnstringMap、Wnrope 节点已经这样做)。
+//    large string 的拷贝是 COW 共享同一块，arena 上的 large string 的拷贝(即使在 Scope 之外做的)
+//    仍指向 arena，同样不能活过 release()；需要留下来的用 Wnstring(s.c_str(), s.size()) 在 Scope 外复制。
+//
+// 来自 arena 的块在 Wnstring 的容量字段中打标记(见 wnstring.h 的 arenaFlag)，释放时不走 free。
+
+struct WnstringAllocator {
+    void* (*allocate)(size_t size);
+    void* (*reallocate)(void* p, size_t size);
+    void (*deallocate)(void* p, size_t size);
+};
+
+// 必须在创建任何 Wnstring 之前调用，否则已有的块会交给不匹配的释放函数
+void setWnstringAllocator(const WnstringAllocator& allocator);
+
+namespace detail {
+
+constexpr size_t kMaxCachedSize = 1024;
+
+// *size 传入需要的字节数，返回实际可用的字节数；*arena 返回块是否来自 arena
+void* stringAllocate(size_t* size, bool* arena);
+// size 为分配时得到的可用字节数(可以偏小)，arena 为分配时的标记
+void stringDeallocate(void* p, size_t size, bool arena);
+// 扩展到至少 *newCapacity 字节并保留前 currentSize 字节，能原地扩展时不复制
+void* stringReallocate(void* p, size_t currentSize, size_t currentCapacity, size_t* newCapacity, bool* arena);
+
+} // namespace detail
+
+class WnstringArena {
+public:
+    explicit WnstringArena(size_t blockSize = 64 * 1024);
+    ~WnstringArena();
+    WnstringArena(const WnstringArena&) = delete;
+    void operator=(const WnstringArena&) = delete;
+
+    void* allocate(size_t* size);
+    // 只有最近一次分配能原地扩展或回退，其他块的释放直接忽略
+    bool tryExtend(void* p, size_t* newSize);
+    void deallocate(void* p);
+    // 一次性归还所有内存块
+    void release();
+    size_t bytesAllocated() const { return bytesAllocated_; }
+
+    // 作用域内本线程的 Wnstring 缓冲区都从该 arena 分配，可以嵌套
+    class Scope {
+    public:
+        explicit Scope(WnstringArena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        void operator=(const Scope&) = delete;
+
+    private:
+        WnstringArena* prev_;
+    };
+
+    // 作用域内暂停本线程的 arena，新分配回到堆上，析构时恢复。用于长寿结构内部的分配
+    class Suspend {
+    public:
+        Suspend();
+        ~Suspend();
+        Suspend(const Suspend&) = delete;
+        void operator=(const Suspend&) = delete;
+
+    private:
+        WnstringArena* prev_;
+    };
+
+private:
+    struct Block {
+        Block* next_;
+        size_t size_;
+    };
+
+    size_t blockSize_;
+    Block* blocks_;
+    char* cur_;
+    char* end_;
+    char* last_; // 最近一次分配的起点
+    size_t bytesAllocated_;
+};
+
+#endif // WNSTRINGALLOC_H
@@ -0,0 +1,255 @@
+#include "wnstringhash.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace detail {
+
+namespace {
+
+constexpr size_t kStripe = 64;
+constexpr size_t kStripesPerBlock = 16;
+constexpr size_t kBlock = kStripe * kStripesPerBlock;
+constexpr size_t kMidSizeMax = 240;
+constexpr size_t kLastStripeKey = 121;
+constexpr uint64_t kPrime32 = 0x9E3779B1ULL;
+constexpr uint64_t kPrime64 = 0x9E3779B185EBCA87ULL;
+
+// 192 字节密钥(splitmix64 序列)。块内第 k 个条带从第 8k 字节起取 64 字节密钥，打散用 kSecret[16..23]
+alignas(32) constexpr uint64_t kSecret[24] = {
+    0x0bd2db2e48789d20ULL, 0x7c621bc543b550a8ULL, 0xb27410639e13de46ULL, 0xd3c4eb1714b569e5ULL,
+    0x9fc8be2266edda39ULL, 0x491e4aceebe4be30ULL, 0x180afb1a9570beb0ULL, 0xca454537878d2950ULL,
+    0xa96a98c828045478ULL, 0xa4a4b920c8e15bf5ULL, 0xae09d92fba683111ULL, 0x1defe04876a32064ULL,
+    0x1b830cede5f3a95fULL, 0x5d45a31f3dd3297fULL, 0x1b37fd03b9ada18eULL, 0xa9cad3754033f149ULL,
+    0x2bbe59b3c2df09d1ULL, 0xc01f604b97fba984ULL, 0xdad0325410c910f5ULL, 0x0677e5dd8bdbadf9ULL,
+    0x2bc9abfd44bc3b36ULL, 0x08cf102312742cefULL, 0x495cf4650c95833dULL, 0x288961efe041bc37ULL,
+};
+
+inline uint64_t read64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 128 位乘积的高低两半异或
+inline uint64_t mum(uint64_t a, uint64_t b)
+{
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t mix16(const char* p, const uint64_t* key)
+{
+    return mum(read64(p) ^ key[0], read64(p + 8) ^ key[1]);
+}
+
+inline uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hashShort(const char* p, size_t n)
+{
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (n > 8) {
+        a = read64(p);
+        b = read64(p + n - 8);
+    } else if (n >= 4) {
+        a = read32(p);
+        b = read32(p + n - 4);
+    } else if (n > 0) {
+        const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+        a = (static_cast<uint64_t>(u[0]) << 16) | (static_cast<uint64_t>(u[n >> 1]) << 8) | u[n - 1];
+    }
+    // 长度在第一次乘法之后再混入：直接异或进 b 会与尾字的低字节相互抵消
+    return avalanche(mum(mum(a ^ kSecret[0], b ^ kSecret[1]) ^ n, kSecret[2]));
+}
+
+uint64_t hashMid(const char* p, size_t n)
+{
+    uint64_t h = n * kPrime64;
+    size_t i = 0;
+    // 每个 16 字节块用不同的密钥对(最多 14 块)，否则交换两个块的内容哈希不变
+    for (; i + 16 < n; i += 16) {
+        h += mix16(p + i, kSecret + i / 16);
+    }
+    h += mix16(p + n - 16, kSecret + 16);
+    return avalanche(h);
+}
+
+// 以下 accumulate* 处理 stripes 个连续条带，key 为第一个条带的密钥，之后每个条带后移 8 字节；
+// scramble* 在每个 1KB 块之后打散累加器。各实现逐位等价
+
+#if !defined(__SSE2__)
+void accumulateScalar(uint64_t* acc, const char* p, size_t stripes, const char* key)
+{
+    for (size_t k = 0; k < stripes; ++k) {
+        const char* s = p + k * kStripe;
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t d = read64(s + i * 8);
+            uint64_t m = d ^ read64(key + (k + i) * 8);
+            acc[i ^ 1] += d;
+            acc[i] += (m & 0xFFFFFFFF) * (m >> 32);
+        }
+    }
+}
+
+void scrambleScalar(uint64_t* acc)
+{
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= kSecret[16 + i];
+        acc[i] = a * kPrime32;
+    }
+}
+#else
+void accumulateSse2(uint64_t* acc, const char* p, size_t stripes, const char* key)
+{
+    __m128i a[4];
+    for (int j = 0; j < 4; ++j) {
+        a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + j);
+    }
+    for (size_t k = 0; k < stripes; ++k) {
+        const __m128i* s = reinterpret_cast<const __m128i*>(p + k * kStripe);
+        const __m128i* kk = reinterpret_cast<const __m128i*>(key + k * 8);
+        for (int j = 0; j < 4; ++j) {
+            __m128i d = _mm_loadu_si128(s + j);
+            __m128i m = _mm_xor_si128(d, _mm_loadu_si128(kk + j));
+            // 交换每个 128 位内的两个 64 位，即 acc[i ^ 1] += d[i]
+            a[j] = _mm_add_epi64(a[j], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[j] = _mm_add_epi64(a[j], _mm_mul_epu32(m, _mm_srli_epi64(m, 32)));
+        }
+    }
+    for (int j = 0; j < 4; ++j) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + j, a[j]);
+    }
+}
+
+void scrambleSse2(uint64_t* acc)
+{
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32));
+    for (int j = 0; j < 4; ++j) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + j);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_load_si128(reinterpret_cast<const __m128i*>(kSecret + 16) + j));
+        // 64 位乘 32 位常数拆成高低两个 32 位乘法
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + j, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+__attribute__((target("avx2")))
+void accumulateAvx2(uint64_t* acc, const char* p, size_t stripes, const char* key)
+{
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+    for (size_t k = 0; k < stripes; ++k) {
+        const char* s = p + k * kStripe;
+        __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+        __m256i m0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + k * 8)));
+        __m256i m1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + k * 8 + 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(m0, _mm256_srli_epi64(m0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(m1, _mm256_srli_epi64(m1, 32)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), a1);
+}
+
+__attribute__((target("avx2")))
+void scrambleAvx2(uint64_t* acc)
+{
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32));
+    for (int j = 0; j < 2; ++j) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + j);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_load_si256(reinterpret_cast<const __m256i*>(kSecret + 16) + j));
+        __m256i lo = _mm256_mul_epu32(a, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + j, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+#endif
+
+struct HashKernels {
+    void (*accumulate)(uint64_t*, const char*, size_t, const char*);
+    void (*scramble)(uint64_t*);
+};
+
+// 运行时按 CPU 支持的指令集选择实现
+HashKernels resolveKernels()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return HashKernels { accumulateAvx2, scrambleAvx2 };
+    }
+    return HashKernels { accumulateSse2, scrambleSse2 };
+#else
+    return HashKernels { accumulateScalar, scrambleScalar };
+#endif
+}
+
+const HashKernels& kernels()
+{
+    static const HashKernels k = resolveKernels();
+    return k;
+}
+
+uint64_t hashLong(const char* p, size_t n)
+{
+    const HashKernels& k = kernels();
+    uint64_t acc[8] = { kPrime32, kPrime64, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+        0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, kPrime32 * kPrime64 };
+    // 最后一个条带总是取末尾 64 字节单独处理(可能与前面重叠)，所以这里只算到 n - 1
+    const char* key = reinterpret_cast<const char*>(kSecret);
+    const size_t blocks = (n - 1) / kBlock;
+    for (size_t b = 0; b < blocks; ++b) {
+        k.accumulate(acc, p + b * kBlock, kStripesPerBlock, key);
+        k.scramble(acc);
+    }
+    const size_t stripes = ((n - 1) - blocks * kBlock) / kStripe;
+    k.accumulate(acc, p + blocks * kBlock, stripes, key);
+    // 非 8 字节对齐的密钥偏移，与块内任何条带都不同；否则与之重叠的条带贡献相同
+    k.accumulate(acc, p + n - kStripe, 1, key + kLastStripeKey);
+
+    uint64_t h = n * kPrime64;
+    for (size_t i = 0; i < 4; ++i) {
+        h += mum(acc[2 * i] ^ kSecret[2 * i + 1], acc[2 * i + 1] ^ kSecret[2 * i + 2]);
+    }
+    return avalanche(h);
+}
+
+} // namespace
+
+uint64_t hashBytes(const char* s, size_t n)
+{
+    if (n <= 16) {
+        return hashShort(s, n);
+    }
+    if (n <= kMidSizeMax) {
+        return hashMid(s, n);
+    }
+    return hashLong(s, n);
+}
+
+} // namespace detail
@@ -0,0 +1,19 @@
+#ifndef WNSTRINGHASH_H
+#define WNSTRINGHASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Wnstring 的哈希内核，wyhash/XXH3 一类的非加密哈希，按长度分三档：
+//   <= 16 字节:   首尾各取一个字读入，一次 128 位乘法折叠
+//   17 ~ 240 字节: 每 16 字节与密钥异或后做 128 位乘法折叠，累加
+//   更长:         8 路 64 位累加器按 64 字节条带并行累加，每 1KB 打散一次，
+//                 SSE2/AVX2 与标量实现结果完全一致，运行时按 CPU 选择
+// 结果只依赖字节内容，不同进程/机器间稳定；不抗碰撞攻击，不要用于不可信输入的防护。
+namespace detail {
+
+uint64_t hashBytes(const char* s, size_t n);
+
+} // namespace detail
+
+#endif // WNSTRINGHASH_H
@@ -0,0 +1,144 @@
+#include "wnstringintern.h"
+#include "wnstringhash.h"
+
+#include <mutex>
+#include <utility>
+
+namespace {
+constexpr size_t kInitialSlots = 16;
+}
+
+const Wnstring* WnstringInternPool::Shard::lookup(const char* s, size_t n, size_t h) const
+{
+    if (slots_.empty()) {
+        return nullptr;
+    }
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        const Wnstring& slot = slots_[i];
+        if (slot.empty()) {
+            return nullptr;
+        }
+        if (hashes_[i] == h && slot.size() == n && memcmp(slot.c_str(), s, n) == 0) {
+            return &slot;
+        }
+    }
+}
+
+void WnstringInternPool::Shard::insert(Wnstring str, size_t h)
+{
+    if ((count_ + 1) * 2 > slots_.size()) {
+        grow();
+    }
+    const size_t mask = slots_.size() - 1;
+    size_t i = h & mask;
+    while (!slots_[i].empty()) {
+        i = (i + 1) & mask;
+    }
+    slots_[i] = std::move(str);
+    hashes_[i] = h;
+    ++count_;
+}
+
+void WnstringInternPool::Shard::grow()
+{
+    std::vector<Wnstring> oldSlots(slots_.empty() ? kInitialSlots : slots_.size() * 2);
+    std::vector<size_t> oldHashes(oldSlots.size());
+    oldSlots.swap(slots_);
+    oldHashes.swap(hashes_);
+    count_ = 0;
+    for (size_t i = 0; i < oldSlots.size(); ++i) {
+        if (!oldSlots[i].empty()) {
+            insert(std::move(oldSlots[i]), oldHashes[i]);
+        }
+    }
+}
+
+Wnstring WnstringInternPool::insert(Wnstring candidate, size_t h)
+{
+    Shard& shard = shardFor(h);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+    // 持读锁到加写锁之间可能有别的线程插入了相同内容
+    if (const Wnstring* found = shard.lookup(candidate.c_str(), candidate.size(), h)) {
+        return *found;
+    }
+    shard.insert(candidate, h);
+    return candidate;
+}
+
+Wnstring WnstringInternPool::intern(const char* s, size_t n)
+{
+    if (n == 0) {
+        return Wnstring();
+    }
+    const size_t h = detail::hashBytes(s, n);
+    {
+        const Shard& shard = shardFor(h);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        if (const Wnstring* found = shard.lookup(s, n, h)) {
+            return *found;
+        }
+    }
+    // 池比任何 Scope 都活得久，入池的副本总在堆上分配
+    WnstringArena::Suspend suspend;
+    Wnstring candidate = Wnstring::makeLarge(s, n);
+    candidate.hash(); // 入池前缓存哈希，驻留串之间的比较靠它快速判不等
+    return insert(std::move(candidate), h);
+}
+
+Wnstring WnstringInternPool::intern(const Wnstring& s)
+{
+    if (s.empty()) {
+        return Wnstring();
+    }
+    const size_t h = s.hash();
+    {
+        const Shard& shard = shardFor(h);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        if (const Wnstring* found = shard.lookup(s.c_str(), s.size(), h)) {
+            return *found;
+        }
+    }
+    // 堆上的 large string 的拷贝就是共享，其余的(包括 arena 上的块)在堆上复制成 large string
+    WnstringArena::Suspend suspend;
+    WnstringView view(s);
+    return insert(view.shared() && !s.arena() ? s : Wnstring::makeLarge(s.c_str(), s.size()), h);
+}
+
+bool WnstringInternPool::find(const char* s, size_t n, Wnstring* out) const
+{
+    const size_t h = detail::hashBytes(s, n);
+    const Shard& shard = shardFor(h);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+    const Wnstring* found = shard.lookup(s, n, h);
+    if (found) {
+        *out = *found;
+    }
+    return found != nullptr;
+}
+
+size_t WnstringInternPool::size() const
+{
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        total += shard.count_;
+    }
+    return total;
+}
+
+void WnstringInternPool::clear()
+{
+    for (Shard& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        std::vector<Wnstring>().swap(shard.slots_);
+        std::vector<size_t>().swap(shard.hashes_);
+        shard.count_ = 0;
+    }
+}
+
+WnstringInternPool& WnstringInternPool::instance()
+{
+    static WnstringInternPool pool;
+    return pool;
+}
@@ -0,0 +1,67 @@
+#ifndef WNSTRINGINTERN_H
+#define WNSTRINGINTERN_H
+
+#include "wnstring.h"
+
+#include <shared_mutex>
+#include <vector>
+
+// 多个模块各自定义了 noncopyable，同时包含时只保留一份
+#ifndef WN_NONCOPYABLE_DEFINED
+#define WN_NONCOPYABLE_DEFINED
+class noncopyable {
+public:
+    noncopyable(const noncopyable&) = delete;
+    void operator=(const noncopyable&) = delete;
+
+protected:
+    noncopyable() = default;
+    ~noncopyable() = default;
+};
+#endif
+
+// 线程安全的字符串驻留池。相同内容只保留一个 large string，intern() 返回它的拷贝，
+// 与池共享同一个 RefCounted 块，重复的键不再各占一份内存。
+// 驻留串的哈希在入池时已缓存，两个驻留串比较时：相等的 data 指针相同，operator== 直接返回；
+// 不等的哈希几乎总不同，同样不必 memcmp。
+// 按哈希高位分成 kShards 片，每片一把读写锁：命中只持读锁，未命中才加写锁插入。
+// 池持有每个串的一个引用，直到 clear() 或池析构。
+class WnstringInternPool : noncopyable {
+public:
+    static constexpr size_t kShards = 64;
+
+    Wnstring intern(const char* s, size_t n);
+    Wnstring intern(const char* s) { return intern(s, strlen(s)); }
+    // s 已是 large string 且池中没有相同内容时直接收下它的块，不复制
+    Wnstring intern(const Wnstring& s);
+    // 只查找不插入
+    bool find(const char* s, size_t n, Wnstring* out) const;
+
+    size_t size() const;
+    void clear();
+
+    // 进程内共用的池
+    static WnstringInternPool& instance();
+
+private:
+    // 开放寻址、线性探测；空槽是空串(驻留的都是非空串)。负载不超过一半
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex_;
+        std::vector<Wnstring> slots_;
+        std::vector<size_t> hashes_;
+        size_t count_ = 0;
+
+        const Wnstring* lookup(const char* s, size_t n, size_t h) const;
+        void insert(Wnstring str, size_t h);
+        void grow();
+    };
+
+    Shard& shardFor(size_t h) { return shards_[h >> 58]; }
+    const Shard& shardFor(size_t h) const { return shards_[h >> 58]; }
+    Wnstring insert(Wnstring candidate, size_t h);
+
+    static_assert(kShards == 64, "shardFor() takes the top 6 bits of the hash");
+    Shard shards_[kShards];
+};
+
+#endif // WNSTRINGINTERN_H
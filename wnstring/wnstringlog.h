@@ -0,0 +1,152 @@
+#ifndef WNSTRINGLOG_H
+#define WNSTRINGLOG_H
+
+#include "wnstring.h"
+#include "../wnlogging/wndigits.h"
+#include "../wnlogging/wnhex.h"
+#include "../wnlogging/wnlogstream.h"
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Wnstring 与 LogStream 之间的桥接，使用时需同时链接 wnlogging/wnlogstream.cc。
+
+// 按已知长度写入日志，不经过 c_str() + strlen
+template <typename RefPolicy>
+inline LogStream& operator<<(LogStream& stream, const BasicWnstring<RefPolicy>& v)
+{
+    return stream << std::string_view(v.c_str(), v.size());
+}
+
+template <typename RefPolicy>
+inline LogStream& operator<<(LogStream& stream, const BasicWnstringView<RefPolicy>& v)
+{
+    return stream << std::string_view(v.data(), v.size());
+}
+
+// 与 LogStream 同样的 operator<< 和格式化函数，输出写进一个可增长的 Wnstring，逐字节与日志一致。
+// 不受 FixedBuffer 的容量限制，按 Wnstring 的 1.5 倍策略扩容；release() 把缓冲直接移交给返回值，不复制。
+// 不超过 23 字节的结果始终留在 SSO 缓冲里，不分配。
+// 用法: Wnstring s = (StringBuilder() << "user=" << id << " cost=" << ms).release();
+template <typename RefPolicy>
+class BasicStringBuilder {
+    typedef BasicStringBuilder self;
+
+public:
+    typedef BasicWnstring<RefPolicy> String;
+
+    BasicStringBuilder() = default;
+    explicit BasicStringBuilder(size_t capacity) { buf_.reserve(capacity); }
+
+    self& operator<<(bool v)
+    {
+        buf_.append(v ? "1" : "0", 1);
+        return *this;
+    }
+    self& operator<<(char v)
+    {
+        buf_.push_back(v);
+        return *this;
+    }
+    self& operator<<(short v) { return formatInteger(static_cast<int>(v)); }
+    self& operator<<(unsigned short v) { return formatInteger(static_cast<unsigned int>(v)); }
+    self& operator<<(int v) { return formatInteger(v); }
+    self& operator<<(unsigned int v) { return formatInteger(v); }
+    self& operator<<(long v) { return formatInteger(v); }
+    self& operator<<(unsigned long v) { return formatInteger(v); }
+    self& operator<<(long long v) { return formatInteger(v); }
+    self& operator<<(unsigned long long v) { return formatInteger(v); }
+
+    self& operator<<(float v) { return *this << static_cast<double>(v); }
+    self& operator<<(double v)
+    {
+        char tmp[detail::kMaxNumericSize];
+        buf_.append(tmp, detail::formatDouble(tmp, v));
+        return *this;
+    }
+    self& operator<<(const void* p)
+    {
+        char tmp[detail::kMaxNumericSize];
+        buf_.append(tmp, detail::formatPointer(tmp, p));
+        return *this;
+    }
+
+    self& operator<<(const char* str)
+    {
+        if (str) {
+            buf_.append(str, strlen(str));
+        } else {
+            buf_.append("(null)", 6);
+        }
+        return *this;
+    }
+    self& operator<<(const unsigned char* str) { return operator<<(reinterpret_cast<const char*>(str)); }
+    self& operator<<(const std::string& v)
+    {
+        buf_.append(v.data(), v.size());
+        return *this;
+    }
+    self& operator<<(std::string_view v)
+    {
+        buf_.append(v.data(), v.size());
+        return *this;
+    }
+    template <typename OtherPolicy>
+    self& operator<<(const BasicWnstring<OtherPolicy>& v)
+    {
+        buf_.append(v.c_str(), v.size());
+        return *this;
+    }
+    template <typename OtherPolicy>
+    self& operator<<(const BasicWnstringView<OtherPolicy>& v)
+    {
+        buf_.append(v.data(), v.size());
+        return *this;
+    }
+
+    // 按块编码进栈上的临时区再追加，长数据也只扩容一次
+    self& operator<<(const Hex& v)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(v.data_);
+        buf_.reserve(buf_.size() + 2 * v.len_);
+        char tmp[128];
+        for (size_t off = 0; off < v.len_; off += sizeof tmp / 2) {
+            const size_t chunk = std::min(v.len_ - off, sizeof tmp / 2);
+            detail::hexEncode(tmp, p + off, chunk, v.upper_);
+            buf_.append(tmp, 2 * chunk);
+        }
+        return *this;
+    }
+
+    void append(const char* data, size_t len) { buf_.append(data, len); }
+    void reserve(size_t capacity) { buf_.reserve(capacity); }
+    void clear() { buf_.clear(); }
+
+    const char* data() const { return buf_.c_str(); }
+    size_t size() const { return buf_.size(); }
+    const String& str() const { return buf_; }
+
+    // 取走结果：缓冲整个移交给返回值，不复制内容。之后 builder 为空，可以继续使用
+    String release() { return String(std::move(buf_)); }
+
+private:
+    template <typename T>
+    self& formatInteger(T v)
+    {
+        char tmp[detail::kMaxNumericSize];
+        const size_t len = std::is_signed<T>::value ? detail::formatSigned(tmp, static_cast<int64_t>(v))
+                                                    : detail::formatUnsigned(tmp, static_cast<uint64_t>(v));
+        buf_.append(tmp, len);
+        return *this;
+    }
+
+    String buf_;
+};
+
+typedef BasicStringBuilder<AtomicRefs> StringBuilder;
+typedef BasicStringBuilder<LocalRefs> LocalStringBuilder;
+
+#endif // WNSTRINGLOG_H
@@ -0,0 +1,368 @@
+#ifndef WNSTRINGMAP_H
+#define WNSTRINGMAP_H
+
+#include "wnstring.h"
+#include "wnstringhash.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// 多个模块各自定义了 noncopyable，同时包含时只保留一份
+#ifndef WN_NONCOPYABLE_DEFINED
+#define WN_NONCOPYABLE_DEFINED
+class noncopyable {
+public:
+    noncopyable(const noncopyable&) = delete;
+    void operator=(const noncopyable&) = delete;
+
+protected:
+    noncopyable() = default;
+    ~noncopyable() = default;
+};
+#endif
+
+namespace detail {
+
+// 控制字节：空槽、删除标记的最高位为 1；满槽存哈希低 7 位(0~127)
+constexpr int8_t kCtrlEmpty = -128; // 0x80
+constexpr int8_t kCtrlDeleted = -2; // 0xFE
+constexpr size_t kGroupWidth = 16;
+
+// 一组 16 个控制字节中等于 b 的位置掩码，SSE2 一次比较整组
+inline uint32_t matchByte(const int8_t* group, int8_t b)
+{
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(b))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+        mask |= static_cast<uint32_t>(group[i] == b) << i;
+    }
+    return mask;
+#endif
+}
+
+// 空槽或删除标记(最高位为 1)的位置掩码
+inline uint32_t matchFree(const int8_t* group)
+{
+#if defined(__SSE2__)
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+        mask |= static_cast<uint32_t>(group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+// 表比任何 WnstringArena::Scope 都活得久，存进表的 Wnstring 不能指向 arena：
+// COW 共享的 large 串和 arena 上的 medium 串都复制一份，须在 Suspend 下调用才会落到堆上。
+// 只处理 Wnstring 本身，其他类型的值不能引用 arena 上的内存。
+template <typename T>
+inline const T& heapCopy(const T& v)
+{
+    return v;
+}
+inline Wnstring heapCopy(const Wnstring& s)
+{
+    return s.arena() ? Wnstring(s.c_str(), s.size()) : s;
+}
+template <typename T>
+inline void detachArena(T&)
+{
+}
+inline void detachArena(Wnstring& s)
+{
+    if (s.arena()) {
+        s = Wnstring(s.c_str(), s.size());
+    }
+}
+
+// 单线程的开放寻址表(swiss table)。
+// 槽按 16 个一组，哈希的高位选组、低 7 位存进控制字节；查找时整组比较控制字节，
+// 只对匹配的槽比较键，遇到含空槽的组即可停止。组间按三角数步长探测，2 的幂组数下能遍历所有组。
+// 键值对直接存放在槽数组里，SSO 范围内的键不会额外分配。
+template <typename V>
+class WnstringTable : noncopyable {
+public:
+    struct Entry {
+        Wnstring key;
+        V value;
+    };
+
+    WnstringTable(): ctrl_(nullptr), slots_(nullptr), capacity_(0), size_(0), deleted_(0) {}
+    ~WnstringTable() { release(); }
+
+    size_t size() const { return size_; }
+
+    Entry* find(const char* s, size_t n, size_t hash) const
+    {
+        if (capacity_ == 0) {
+            return nullptr;
+        }
+        const int8_t h2 = static_cast<int8_t>(hash & 0x7F);
+        const size_t mask = capacity_ / kGroupWidth - 1;
+        size_t g = (hash >> 7) & mask;
+        for (size_t step = 1;; ++step) {
+            const int8_t* group = ctrl_ + g * kGroupWidth;
+            for (uint32_t m = matchByte(group, h2); m; m &= m - 1) {
+                Entry* e = slots_ + g * kGroupWidth + __builtin_ctz(m);
+                // 共享同一块的 large key(例如驻留的串)只比指针
+                if (e->key.size() == n && (e->key.c_str() == s || memcmp(e->key.c_str(), s, n) == 0)) {
+                    return e;
+                }
+            }
+            if (matchByte(group, kCtrlEmpty)) {
+                return nullptr;
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    // 返回键所在的槽和是否新插入；已存在时不修改值
+    template <typename... Args>
+    std::pair<Entry*, bool> emplace(const Wnstring& key, size_t hash, Args&&... args)
+    {
+        if (Entry* e = find(key.c_str(), key.size(), hash)) {
+            return std::make_pair(e, false);
+        }
+        // 负载(含删除标记)不超过 7/8。大多是删除标记时原容量重建即可
+        if ((size_ + deleted_ + 1) * 8 > capacity_ * 7) {
+            rehash(capacity_ == 0 ? kGroupWidth : ((size_ + 1) * 16 > capacity_ * 7 ? capacity_ * 2 : capacity_));
+        }
+        size_t index = findFree(hash);
+        Entry* e;
+        {
+            // 表比任何 Scope 都活得久：key 和值都在堆上分配，指向 arena 的 Wnstring 复制而不共享
+            WnstringArena::Suspend suspend;
+            // 先构造再标记满槽，拷贝或 V 的构造抛异常时槽位保持原状
+            e = new (slots_ + index) Entry { heapCopy(key), V(heapCopy(std::forward<Args>(args))...) };
+        }
+        if (ctrl_[index] == kCtrlDeleted) {
+            --deleted_;
+        }
+        ctrl_[index] = static_cast<int8_t>(hash & 0x7F);
+        ++size_;
+        return std::make_pair(e, true);
+    }
+
+    bool erase(const char* s, size_t n, size_t hash)
+    {
+        Entry* e = find(s, n, hash);
+        if (!e) {
+            return false;
+        }
+        const size_t index = e - slots_;
+        e->~Entry();
+        // 所在组还有空槽时，探测序列不会越过这一组，可以直接置空而不留删除标记
+        ctrl_[index] = matchByte(ctrl_ + index / kGroupWidth * kGroupWidth, kCtrlEmpty) ? kCtrlEmpty : kCtrlDeleted;
+        if (ctrl_[index] == kCtrlDeleted) {
+            ++deleted_;
+        }
+        --size_;
+        return true;
+    }
+
+    template <typename F>
+    void forEach(F& f) const
+    {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                f(const_cast<const Wnstring&>(slots_[i].key), const_cast<const V&>(slots_[i].value));
+            }
+        }
+    }
+
+    void clear()
+    {
+        release();
+        ctrl_ = nullptr;
+        slots_ = nullptr;
+        capacity_ = size_ = deleted_ = 0;
+    }
+
+private:
+    size_t findFree(size_t hash) const
+    {
+        const size_t mask = capacity_ / kGroupWidth - 1;
+        size_t g = (hash >> 7) & mask;
+        for (size_t step = 1;; ++step) {
+            uint32_t m = matchFree(ctrl_ + g * kGroupWidth);
+            if (m) {
+                return g * kGroupWidth + __builtin_ctz(m);
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        int8_t* oldCtrl = ctrl_;
+        Entry* oldSlots = slots_;
+        const size_t oldCapacity = capacity_;
+
+        ctrl_ = new int8_t[newCapacity];
+        memset(ctrl_, kCtrlEmpty, newCapacity);
+        slots_ = static_cast<Entry*>(::operator new(newCapacity * sizeof(Entry)));
+        capacity_ = newCapacity;
+        deleted_ = 0;
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] >= 0) {
+                Entry& e = oldSlots[i];
+                const size_t hash = e.key.hash();
+                const size_t index = findFree(hash);
+                ctrl_[index] = static_cast<int8_t>(hash & 0x7F);
+                new (slots_ + index) Entry(std::move(e));
+                e.~Entry();
+            }
+        }
+        delete[] oldCtrl;
+        ::operator delete(oldSlots);
+    }
+
+    void release()
+    {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) {
+                slots_[i].~Entry();
+            }
+        }
+        delete[] ctrl_;
+        ::operator delete(slots_);
+    }
+
+    int8_t* ctrl_;
+    Entry* slots_;
+    size_t capacity_; // 槽数，2 的幂且是 kGroupWidth 的倍数
+    size_t size_;
+    size_t deleted_;
+};
+
+} // namespace detail
+
+// 以 Wnstring 为键的并发哈希表。
+// 按哈希最高 6 位分成 64 个分片，每片是一张 swiss table 和一把读写锁，分片各占独立的缓存行：
+// 读之间完全并行，写只阻塞同一分片，其余分片上的读写照常进行。
+// 值按拷贝取出(find)或在锁内就地修改(update)，不返回指向表内的引用。
+// 键的哈希用 Wnstring::hash()，large key 的哈希缓存在共享块中，驻留过的键查找时只比指针。
+// 在 WnstringArena::Scope 内写入也安全：Wnstring 键和值复制到堆上，其他类型的值不能引用 arena 上的内存。
+template <typename V>
+class WnstringMap : noncopyable {
+public:
+    static constexpr size_t kShards = 64;
+
+    // 已存在时不覆盖，返回 false
+    bool insert(const Wnstring& key, const V& value)
+    {
+        const size_t h = key.hash();
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        return shard.table_.emplace(key, h, value).second;
+    }
+    void insert_or_assign(const Wnstring& key, const V& value)
+    {
+        const size_t h = key.hash();
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        auto r = shard.table_.emplace(key, h, value);
+        if (!r.second) {
+            WnstringArena::Suspend suspend;
+            r.first->value = detail::heapCopy(value);
+        }
+    }
+    // 键不存在时先插入默认值，再在写锁内调用 f(V&)。
+    // f 在 Suspend 下运行，f 写入的 Wnstring 值若仍指向 arena 会再复制到堆上
+    template <typename F>
+    void update(const Wnstring& key, F f)
+    {
+        const size_t h = key.hash();
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        V& value = shard.table_.emplace(key, h).first->value;
+        WnstringArena::Suspend suspend;
+        try {
+            f(value);
+        } catch (...) {
+            detail::detachArena(value);
+            throw;
+        }
+        detail::detachArena(value);
+    }
+
+    bool find(const Wnstring& key, V* out) const { return findHashed(key.c_str(), key.size(), key.hash(), out); }
+    // 不构造 Wnstring 直接按字节查找
+    bool find(const char* s, size_t n, V* out) const { return findHashed(s, n, detail::hashBytes(s, n), out); }
+    bool contains(const Wnstring& key) const { return findHashed(key.c_str(), key.size(), key.hash(), nullptr); }
+
+    bool erase(const Wnstring& key)
+    {
+        const size_t h = key.hash();
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+        return shard.table_.erase(key.c_str(), key.size(), h);
+    }
+
+    // 逐个分片持读锁遍历，f(const Wnstring&, const V&)。不是整表快照
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (const Shard& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+            shard.table_.forEach(f);
+        }
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const Shard& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+            total += shard.table_.size();
+        }
+        return total;
+    }
+
+    void clear()
+    {
+        for (Shard& shard : shards_) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+            shard.table_.clear();
+        }
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex_;
+        detail::WnstringTable<V> table_;
+    };
+
+    bool findHashed(const char* s, size_t n, size_t h, V* out) const
+    {
+        const Shard& shard = shardFor(h);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+        const auto* e = shard.table_.find(s, n, h);
+        if (e && out) {
+            *out = e->value;
+        }
+        return e != nullptr;
+    }
+
+    // 分片用最高位，表内选组用 hash >> 7 的低位，两者不相关
+    Shard& shardFor(size_t h) { return shards_[h >> 58]; }
+    const Shard& shardFor(size_t h) const { return shards_[h >> 58]; }
+
+    static_assert(kShards == 64, "shardFor() takes the top 6 bits of the hash");
+    Shard shards_[kShards];
+};
+
+#endif // WNSTRINGMAP_H
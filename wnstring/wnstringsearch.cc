@@ -0,0 +1,343 @@
+#include "wnstringsearch.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace detail {
+
+namespace {
+
+// 以下 filter* 由调用方保证 2 <= m <= n
+
+size_t filterForwardScalar(const char* s, size_t n, const char* needle, size_t m)
+{
+    for (size_t i = 0; i + m <= n; ++i) {
+        if (s[i] == needle[0] && s[i + m - 1] == needle[m - 1] && memcmp(s + i + 1, needle + 1, m - 2) == 0) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+size_t filterBackwardScalar(const char* s, size_t n, const char* needle, size_t m)
+{
+    for (size_t i = n - m + 1; i-- > 0;) {
+        if (s[i] == needle[0] && s[i + m - 1] == needle[m - 1] && memcmp(s + i + 1, needle + 1, m - 2) == 0) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+size_t firstOfScalar(const char* s, size_t n, const char* set, size_t m)
+{
+    uint64_t bits[4] = { 0, 0, 0, 0 };
+    for (size_t k = 0; k < m; ++k) {
+        unsigned char c = static_cast<unsigned char>(set[k]);
+        bits[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (bits[c >> 6] & (uint64_t(1) << (c & 63))) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+#if defined(__SSE2__)
+// 一次比较 16 个候选起点：起点字节等于 needle 首字节、且对应末尾字节等于 needle 末字节
+size_t filterForwardSse2(const char* s, size_t n, const char* needle, size_t m)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t r = filterForwardScalar(s + i, n - i, needle, m);
+    return r == kNotFound ? r : i + r;
+}
+
+// 从尾部往前取块，块内取最高位即最靠后的候选
+size_t filterBackwardSse2(const char* s, size_t n, const char* needle, size_t m)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    size_t end = n - m + 1; // 尚未检查的候选起点为 [0, end)
+    while (end >= 16) {
+        size_t b = end - 16;
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + b));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + b + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, first), _mm_cmpeq_epi8(y, last)));
+        while (mask != 0) {
+            int bit = 31 - __builtin_clz(mask);
+            size_t pos = b + bit;
+            if (memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+            mask &= ~(1u << bit);
+        }
+        end = b;
+    }
+    return end == 0 ? kNotFound : filterBackwardScalar(s, end + m - 1, needle, m);
+}
+
+// 字符集不大时逐个字符比较再取或；更大的集合走标量位图
+const size_t kMaxSimdSet = 8;
+
+size_t firstOfSse2(const char* s, size_t n, const char* set, size_t m)
+{
+    if (m > kMaxSimdSet) {
+        return firstOfScalar(s, n, set, m);
+    }
+    __m128i vs[kMaxSimdSet];
+    for (size_t k = 0; k < m; ++k) {
+        vs[k] = _mm_set1_epi8(set[k]);
+    }
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i hit = _mm_cmpeq_epi8(b, vs[0]);
+        for (size_t k = 1; k < m; ++k) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(b, vs[k]));
+        }
+        unsigned mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t r = firstOfScalar(s + i, n - i, set, m);
+    return r == kNotFound ? r : i + r;
+}
+
+__attribute__((target("avx2")))
+size_t filterForwardAvx2(const char* s, size_t n, const char* needle, size_t m)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+        while (mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    size_t r = filterForwardSse2(s + i, n - i, needle, m);
+    return r == kNotFound ? r : i + r;
+}
+
+__attribute__((target("avx2")))
+size_t filterBackwardAvx2(const char* s, size_t n, const char* needle, size_t m)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    size_t end = n - m + 1;
+    while (end >= 32) {
+        size_t b = end - 32;
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + b));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + b + m - 1));
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, first), _mm256_cmpeq_epi8(y, last))));
+        while (mask != 0) {
+            int bit = 31 - __builtin_clz(mask);
+            size_t pos = b + bit;
+            if (memcmp(s + pos + 1, needle + 1, m - 2) == 0) {
+                return pos;
+            }
+            mask &= ~(1u << bit);
+        }
+        end = b;
+    }
+    return end == 0 ? kNotFound : filterBackwardSse2(s, end + m - 1, needle, m);
+}
+
+__attribute__((target("avx2")))
+size_t firstOfAvx2(const char* s, size_t n, const char* set, size_t m)
+{
+    if (m > kMaxSimdSet) {
+        return firstOfScalar(s, n, set, m);
+    }
+    __m256i vs[kMaxSimdSet];
+    for (size_t k = 0; k < m; ++k) {
+        vs[k] = _mm256_set1_epi8(set[k]);
+    }
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i hit = _mm256_cmpeq_epi8(b, vs[0]);
+        for (size_t k = 1; k < m; ++k) {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(b, vs[k]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t r = firstOfSse2(s + i, n - i, set, m);
+    return r == kNotFound ? r : i + r;
+}
+#endif
+
+// Horspool：窗口末字节 c 失配时，窗口可以右移到 needle 中 c 最后一次出现(不含末位)处对齐
+size_t horspoolForward(const char* s, size_t n, const char* needle, size_t m)
+{
+    size_t skip[256];
+    for (size_t c = 0; c < 256; ++c) {
+        skip[c] = m;
+    }
+    for (size_t k = 0; k + 1 < m; ++k) {
+        skip[static_cast<unsigned char>(needle[k])] = m - 1 - k;
+    }
+    const char last = needle[m - 1];
+    for (size_t i = 0; i + m <= n;) {
+        char c = s[i + m - 1];
+        if (c == last && memcmp(s + i, needle, m - 1) == 0) {
+            return i;
+        }
+        i += skip[static_cast<unsigned char>(c)];
+    }
+    return kNotFound;
+}
+
+// 反向 Horspool：以窗口首字节为坏字符，窗口向左移到 needle 中 c 第一次出现(不含首位)处对齐
+size_t horspoolBackward(const char* s, size_t n, const char* needle, size_t m)
+{
+    size_t skip[256];
+    for (size_t c = 0; c < 256; ++c) {
+        skip[c] = m;
+    }
+    for (size_t k = m - 1; k >= 1; --k) {
+        skip[static_cast<unsigned char>(needle[k])] = k;
+    }
+    const char first = needle[0];
+    size_t i = n - m;
+    for (;;) {
+        char c = s[i];
+        if (c == first && memcmp(s + i + 1, needle + 1, m - 1) == 0) {
+            return i;
+        }
+        size_t shift = skip[static_cast<unsigned char>(c)];
+        if (i < shift) {
+            return kNotFound;
+        }
+        i -= shift;
+    }
+}
+
+typedef size_t (*SearchFunc)(const char*, size_t, const char*, size_t);
+
+struct SearchKernels {
+    SearchFunc forward;
+    SearchFunc backward;
+    SearchFunc firstOf;
+};
+
+// 运行时按 CPU 支持的指令集选择实现
+SearchKernels resolveKernels()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SearchKernels { filterForwardAvx2, filterBackwardAvx2, firstOfAvx2 };
+    }
+    return SearchKernels { filterForwardSse2, filterBackwardSse2, firstOfSse2 };
+#else
+    return SearchKernels { filterForwardScalar, filterBackwardScalar, firstOfScalar };
+#endif
+}
+
+const SearchKernels& kernels()
+{
+    static const SearchKernels k = resolveKernels();
+    return k;
+}
+
+} // namespace
+
+size_t searchForward(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) {
+        return 0;
+    }
+    if (m > n) {
+        return kNotFound;
+    }
+    if (m == 1) {
+        const void* p = memchr(hay, needle[0], n);
+        return p ? static_cast<const char*>(p) - hay : kNotFound;
+    }
+    if (m <= kLongNeedle) {
+        return kernels().forward(hay, n, needle, m);
+    }
+    return horspoolForward(hay, n, needle, m);
+}
+
+size_t searchBackward(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) {
+        return n;
+    }
+    if (m > n) {
+        return kNotFound;
+    }
+    if (m == 1) {
+        const void* p = memrchr(hay, needle[0], n);
+        return p ? static_cast<const char*>(p) - hay : kNotFound;
+    }
+    if (m <= kLongNeedle) {
+        return kernels().backward(hay, n, needle, m);
+    }
+    return horspoolBackward(hay, n, needle, m);
+}
+
+size_t searchFirstOf(const char* s, size_t n, const char* set, size_t m)
+{
+    if (m == 0 || n == 0) {
+        return kNotFound;
+    }
+    if (m == 1) {
+        const void* p = memchr(s, set[0], n);
+        return p ? static_cast<const char*>(p) - s : kNotFound;
+    }
+    return kernels().firstOf(s, n, set, m);
+}
+
+size_t countOccurrences(const char* hay, size_t n, const char* needle, size_t m)
+{
+    if (m == 0) {
+        return 0;
+    }
+    size_t count = 0;
+    size_t pos = 0;
+    for (;;) {
+        size_t r = searchForward(hay + pos, n - pos, needle, m);
+        if (r == kNotFound) {
+            return count;
+        }
+        ++count;
+        pos += r + m;
+    }
+}
+
+} // namespace detail
@@ -0,0 +1,27 @@
+#ifndef WNSTRINGSEARCH_H
+#define WNSTRINGSEARCH_H
+
+#include <cstddef>
+
+// Wnstring 查找用的内核。返回 hay 中的下标，找不到返回 kNotFound（与 Wnstring::npos 相同）。
+// 按 needle 长度选择算法：
+//   1 字节:                 memchr / memrchr
+//   2 ~ kLongNeedle 字节:   SSE2/AVX2 首尾字节过滤，候选位置再 memcmp 确认
+//   更长:                   Boyer-Moore-Horspool，失配时按坏字符一次跳过多个字节
+namespace detail {
+
+constexpr size_t kNotFound = static_cast<size_t>(-1);
+constexpr size_t kLongNeedle = 32;
+
+// needle 第一次出现的位置；空 needle 返回 0
+size_t searchForward(const char* hay, size_t n, const char* needle, size_t m);
+// needle 最后一次出现的位置；空 needle 返回 n
+size_t searchBackward(const char* hay, size_t n, const char* needle, size_t m);
+// 第一个属于字符集 set 的字节
+size_t searchFirstOf(const char* s, size_t n, const char* set, size_t m);
+// needle 不重叠出现的次数；空 needle 返回 0
+size_t countOccurrences(const char* hay, size_t n, const char* needle, size_t m);
+
+} // namespace detail
+
+#endif // WNSTRINGSEARCH_H
@@ -0,0 +1,546 @@
+#include "wnstringutf8.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace detail {
+
+namespace {
+
+// 解码 s[i] 开始的一个字符，返回字节数；非法返回 0
+inline size_t decodeOne(const unsigned char* s, size_t n, size_t i, uint32_t* cp)
+{
+    const uint32_t c = s[i];
+    if (c < 0x80) {
+        *cp = c;
+        return 1;
+    }
+    if (c < 0xC2) { // 单独的续字节，或 0xC0/0xC1 开头的 2 字节超长编码
+        return 0;
+    }
+    if (c < 0xE0) {
+        if (i + 2 > n || (s[i + 1] & 0xC0) != 0x80) {
+            return 0;
+        }
+        *cp = ((c & 0x1F) << 6) | (s[i + 1] & 0x3F);
+        return 2;
+    }
+    if (c < 0xF0) {
+        if (i + 3 > n || (s[i + 1] & 0xC0) != 0x80 || (s[i + 2] & 0xC0) != 0x80) {
+            return 0;
+        }
+        // E0 后不能小于 A0(超长)，ED 后不能大于 9F(代理区)
+        if ((c == 0xE0 && s[i + 1] < 0xA0) || (c == 0xED && s[i + 1] > 0x9F)) {
+            return 0;
+        }
+        *cp = ((c & 0x0F) << 12) | ((s[i + 1] & 0x3F) << 6) | (s[i + 2] & 0x3F);
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (i + 4 > n || (s[i + 1] & 0xC0) != 0x80 || (s[i + 2] & 0xC0) != 0x80 || (s[i + 3] & 0xC0) != 0x80) {
+            return 0;
+        }
+        // F0 后不能小于 90(超长)，F4 后不能大于 8F(超过 U+10FFFF)
+        if ((c == 0xF0 && s[i + 1] < 0x90) || (c == 0xF4 && s[i + 1] > 0x8F)) {
+            return 0;
+        }
+        *cp = ((c & 0x07) << 18) | ((s[i + 1] & 0x3F) << 12) | ((s[i + 2] & 0x3F) << 6) | (s[i + 3] & 0x3F);
+        return 4;
+    }
+    return 0;
+}
+
+// 从字符边界 i 逐字符校验，直到越过 stop。返回停下的位置(仍是字符边界)，非法返回 kNotFound
+size_t advanceScalar(const unsigned char* s, size_t n, size_t i, size_t stop)
+{
+    uint32_t cp;
+    while (i < stop) {
+        const size_t len = decodeOne(s, n, i, &cp);
+        if (len == 0) {
+            return kNotFound;
+        }
+        i += len;
+    }
+    return i;
+}
+
+// 从 s[i]/o 开始逐字符转码，直到输入越过 stop
+bool toUtf16Scalar(const unsigned char* s, size_t n, size_t* i, size_t stop, char16_t* out, size_t* o)
+{
+    uint32_t cp;
+    while (*i < stop) {
+        const size_t len = decodeOne(s, n, *i, &cp);
+        if (len == 0) {
+            return false;
+        }
+        *i += len;
+        if (cp < 0x10000) {
+            out[(*o)++] = static_cast<char16_t>(cp);
+        } else {
+            cp -= 0x10000;
+            out[(*o)++] = static_cast<char16_t>(0xD800 + (cp >> 10));
+            out[(*o)++] = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+        }
+    }
+    return true;
+}
+
+bool toUtf8Scalar(const char16_t* s, size_t n, size_t* i, size_t stop, char* out, size_t* o)
+{
+    while (*i < stop) {
+        uint32_t c = s[(*i)++];
+        if (c < 0x80) {
+            out[(*o)++] = static_cast<char>(c);
+            continue;
+        }
+        if (c < 0x800) {
+            out[(*o)++] = static_cast<char>(0xC0 | (c >> 6));
+            out[(*o)++] = static_cast<char>(0x80 | (c & 0x3F));
+            continue;
+        }
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            // 必须是高代理后跟低代理
+            if (c > 0xDBFF || *i >= n || s[*i] < 0xDC00 || s[*i] > 0xDFFF) {
+                return false;
+            }
+            c = 0x10000 + ((c - 0xD800) << 10) + (s[(*i)++] - 0xDC00);
+            out[(*o)++] = static_cast<char>(0xF0 | (c >> 18));
+            out[(*o)++] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        } else {
+            out[(*o)++] = static_cast<char>(0xE0 | (c >> 12));
+        }
+        out[(*o)++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out[(*o)++] = static_cast<char>(0x80 | (c & 0x3F));
+    }
+    return true;
+}
+
+inline bool isLetter(unsigned char c, char first)
+{
+    return static_cast<unsigned char>(c - first) < 26;
+}
+
+#if !defined(__SSE2__)
+bool validateScalar(const char* s, size_t n)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    size_t i = 0;
+    while (i < n) {
+        // 一次跳过 8 个 ASCII 字节
+        if (i + 8 <= n) {
+            uint64_t w;
+            memcpy(&w, u + i, sizeof w);
+            if ((w & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        i = advanceScalar(u, n, i, i + 1);
+        if (i == kNotFound) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t findLetterScalar(const char* s, size_t n, char first)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (isLetter(s[i], first)) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+void flipCaseScalar(char* s, size_t n, char first)
+{
+    for (size_t i = 0; i < n; ++i) {
+        s[i] ^= isLetter(s[i], first) ? 0x20 : 0;
+    }
+}
+
+size_t toUtf16ScalarAll(const char* s, size_t n, char16_t* out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    return toUtf16Scalar(reinterpret_cast<const unsigned char*>(s), n, &i, n, out, &o) ? o : kNotFound;
+}
+
+size_t toUtf8ScalarAll(const char16_t* s, size_t n, char* out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    return toUtf8Scalar(s, n, &i, n, out, &o) ? o : kNotFound;
+}
+#else
+bool validateSse2(const char* s, size_t n)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    size_t i = 0;
+    while (i + 16 <= n) {
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+        if (mask == 0) {
+            i += 16;
+            continue;
+        }
+        // 块内第一个非 ASCII 字节之前都是完整字符，从那里逐字符校验到块后第一个字符边界
+        i = advanceScalar(u, n, i + __builtin_ctz(mask), i + 16);
+        if (i == kNotFound) {
+            return false;
+        }
+    }
+    return advanceScalar(u, n, i, n) != kNotFound;
+}
+
+// 字节落在 [first, first + 25] 的掩码：平移到有符号数的最小端后做一次有符号比较
+inline __m128i letterMaskSse2(__m128i v, char first)
+{
+    const __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - first)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+}
+
+size_t findLetterSse2(const char* s, size_t n, char first)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        int mask = _mm_movemask_epi8(letterMaskSse2(v, first));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    for (; i < n; ++i) {
+        if (isLetter(s[i], first)) {
+            return i;
+        }
+    }
+    return kNotFound;
+}
+
+void flipCaseSse2(char* s, size_t n, char first)
+{
+    const __m128i bit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i* p = reinterpret_cast<__m128i*>(s + i);
+        __m128i v = _mm_loadu_si128(p);
+        _mm_storeu_si128(p, _mm_xor_si128(v, _mm_and_si128(letterMaskSse2(v, first), bit)));
+    }
+    for (; i < n; ++i) {
+        s[i] ^= isLetter(s[i], first) ? 0x20 : 0;
+    }
+}
+
+size_t toUtf16Sse2(const char* s, size_t n, char16_t* out)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    size_t o = 0;
+    while (i + 16 <= n) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        if (_mm_movemask_epi8(v) == 0) {
+            // 零扩展成 16 个 char16_t
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(v, zero));
+            i += 16;
+            o += 16;
+            continue;
+        }
+        if (!toUtf16Scalar(u, n, &i, i + 16, out, &o)) {
+            return kNotFound;
+        }
+    }
+    return toUtf16Scalar(u, n, &i, n, out, &o) ? o : kNotFound;
+}
+
+size_t toUtf8Sse2(const char16_t* s, size_t n, char* out)
+{
+    const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    size_t o = 0;
+    while (i + 16 <= n) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 8));
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(a, b), high);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, zero)) == 0xFFFF) {
+            // 16 个单元都小于 0x80，饱和压缩成 16 字节
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(a, b));
+            i += 16;
+            o += 16;
+            continue;
+        }
+        if (!toUtf8Scalar(s, n, &i, i + 16, out, &o)) {
+            return kNotFound;
+        }
+    }
+    return toUtf8Scalar(s, n, &i, n, out, &o) ? o : kNotFound;
+}
+
+// Keiser-Lemire 查表法用的三张表。每个错误类别占一位，
+// 三张表分别以前一字节的高/低半字节和当前字节的高半字节为下标，三者相与非零即为非法组合
+constexpr uint8_t kTooShort = 1 << 0; // 前导字节后跟 ASCII 或另一个前导字节
+constexpr uint8_t kTooLong = 1 << 1; // ASCII 后跟续字节
+constexpr uint8_t kOverlong3 = 1 << 2; // E0 80..9F
+constexpr uint8_t kTooLarge = 1 << 3; // F4 90..BF，F5..FF 后跟 90..BF
+constexpr uint8_t kSurrogate = 1 << 4; // ED A0..BF
+constexpr uint8_t kOverlong2 = 1 << 5; // C0/C1 后跟续字节
+constexpr uint8_t kTooLarge1000 = 1 << 6; // F5..FF 后跟 80..8F
+constexpr uint8_t kOverlong4 = 1 << 6; // F0 80..8F
+constexpr uint8_t kTwoConts = 1 << 7; // 续字节后跟续字节(是否合法由前 2/3 个字节决定)
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+alignas(16) constexpr uint8_t kByte1High[16] = {
+    kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, // 0___
+    kTwoConts, kTwoConts, kTwoConts, kTwoConts, // 10__
+    kTooShort | kOverlong2, // 1100
+    kTooShort, // 1101
+    kTooShort | kOverlong3 | kSurrogate, // 1110
+    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4, // 1111
+};
+
+alignas(16) constexpr uint8_t kByte1Low[16] = {
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4, // ____0000
+    kCarry | kOverlong2, // ____0001
+    kCarry,
+    kCarry,
+    kCarry | kTooLarge, // ____0100
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000 | kSurrogate, // ____1101
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+};
+
+alignas(16) constexpr uint8_t kByte2High[16] = {
+    kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, // 0___
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4, // 1000
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge, // 1001
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge, // 1010
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge, // 1011
+    kTooShort, kTooShort, kTooShort, kTooShort, // 11__
+};
+
+__attribute__((target("avx2")))
+inline __m256i loadTableAvx2(const uint8_t* table)
+{
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+// 当前 32 字节 in 与前 32 字节 prev 拼接后，每个位置前第 1/2/3 个字节
+#define WN_PREV_BYTES(in, prev, k) \
+    _mm256_alignr_epi8(in, _mm256_permute2x128_si256(prev, in, 0x21), 16 - (k))
+
+// 非零的字节即非法
+__attribute__((target("avx2")))
+inline __m256i checkBlockAvx2(__m256i in, __m256i prev, __m256i t1h, __m256i t1l, __m256i t2h)
+{
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    const __m256i prev1 = WN_PREV_BYTES(in, prev, 1);
+    const __m256i b1h = _mm256_shuffle_epi8(t1h, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low));
+    const __m256i b1l = _mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, low));
+    const __m256i b2h = _mm256_shuffle_epi8(t2h, _mm256_and_si256(_mm256_srli_epi16(in, 4), low));
+    const __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+    // 3/4 字节序列的第 3、4 个字节：前第 2 个字节 >= E0 或前第 3 个字节 >= F0，此时续字节后跟续字节才合法
+    const __m256i third = _mm256_subs_epu8(WN_PREV_BYTES(in, prev, 2), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m256i fourth = _mm256_subs_epu8(WN_PREV_BYTES(in, prev, 3), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+#undef WN_PREV_BYTES
+
+// 块末尾的序列是否未完结：最后 3 个字节中有还需要更多续字节的前导字节
+__attribute__((target("avx2")))
+inline __m256i incompleteAvx2(__m256i in)
+{
+    const __m256i limit = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xF0 - 1),
+        static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(in, limit);
+}
+
+__attribute__((target("avx2")))
+bool validateAvx2(const char* s, size_t n)
+{
+    const __m256i t1h = loadTableAvx2(kByte1High);
+    const __m256i t1l = loadTableAvx2(kByte1Low);
+    const __m256i t2h = loadTableAvx2(kByte2High);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    alignas(32) char tail[32];
+    for (size_t i = 0; i < n; i += 32) {
+        const char* p = s + i;
+        if (i + 32 > n) {
+            // 尾部补 0(ASCII)凑满一块
+            memset(tail, 0, sizeof tail);
+            memcpy(tail, p, n - i);
+            p = tail;
+        }
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if (_mm256_movemask_epi8(in) == 0) {
+            // 全 ASCII：只需确认上一块没有以未完结的序列结尾
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(error, checkBlockAvx2(in, prev, t1h, t1l, t2h));
+            incomplete = incompleteAvx2(in);
+        }
+        prev = in;
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+__attribute__((target("avx2")))
+inline __m256i letterMaskAvx2(__m256i v, char first)
+{
+    const __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(0x80 - first)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 26)), shifted);
+}
+
+__attribute__((target("avx2")))
+size_t findLetterAvx2(const char* s, size_t n, char first)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(letterMaskAvx2(v, first)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    size_t r = findLetterSse2(s + i, n - i, first);
+    return r == kNotFound ? r : i + r;
+}
+
+__attribute__((target("avx2")))
+void flipCaseAvx2(char* s, size_t n, char first)
+{
+    const __m256i bit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i* p = reinterpret_cast<__m256i*>(s + i);
+        __m256i v = _mm256_loadu_si256(p);
+        _mm256_storeu_si256(p, _mm256_xor_si256(v, _mm256_and_si256(letterMaskAvx2(v, first), bit)));
+    }
+    flipCaseSse2(s + i, n - i, first);
+}
+
+__attribute__((target("avx2")))
+size_t toUtf16Avx2(const char* s, size_t n, char16_t* out)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(s);
+    size_t i = 0;
+    size_t o = 0;
+    while (i + 32 <= n) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        if (_mm256_movemask_epi8(v) == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o + 16),
+                _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+            i += 32;
+            o += 32;
+            continue;
+        }
+        if (!toUtf16Scalar(u, n, &i, i + 32, out, &o)) {
+            return kNotFound;
+        }
+    }
+    return toUtf16Scalar(u, n, &i, n, out, &o) ? o : kNotFound;
+}
+
+__attribute__((target("avx2")))
+size_t toUtf8Avx2(const char16_t* s, size_t n, char* out)
+{
+    const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    size_t o = 0;
+    while (i + 32 <= n) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 16));
+        if (_mm256_testz_si256(_mm256_or_si256(a, b), high)) {
+            // packus 按 128 位通道交错，再把 64 位块排回原顺序
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), packed);
+            i += 32;
+            o += 32;
+            continue;
+        }
+        if (!toUtf8Scalar(s, n, &i, i + 32, out, &o)) {
+            return kNotFound;
+        }
+    }
+    return toUtf8Scalar(s, n, &i, n, out, &o) ? o : kNotFound;
+}
+#endif
+
+struct Utf8Kernels {
+    bool (*validate)(const char*, size_t);
+    size_t (*findLetter)(const char*, size_t, char);
+    void (*flipCase)(char*, size_t, char);
+    size_t (*toUtf16)(const char*, size_t, char16_t*);
+    size_t (*toUtf8)(const char16_t*, size_t, char*);
+};
+
+// 运行时按 CPU 支持的指令集选择实现
+Utf8Kernels resolveKernels()
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Utf8Kernels { validateAvx2, findLetterAvx2, flipCaseAvx2, toUtf16Avx2, toUtf8Avx2 };
+    }
+    return Utf8Kernels { validateSse2, findLetterSse2, flipCaseSse2, toUtf16Sse2, toUtf8Sse2 };
+#else
+    return Utf8Kernels { validateScalar, findLetterScalar, flipCaseScalar, toUtf16ScalarAll, toUtf8ScalarAll };
+#endif
+}
+
+const Utf8Kernels& kernels()
+{
+    static const Utf8Kernels k = resolveKernels();
+    return k;
+}
+
+} // namespace
+
+bool validateUtf8(const char* s, size_t n)
+{
+    return kernels().validate(s, n);
+}
+
+size_t findAsciiLetter(const char* s, size_t n, char first)
+{
+    return kernels().findLetter(s, n, first);
+}
+
+void flipAsciiCase(char* s, size_t n, char first)
+{
+    kernels().flipCase(s, n, first);
+}
+
+size_t utf8ToUtf16(const char* s, size_t n, char16_t* out)
+{
+    return kernels().toUtf16(s, n, out);
+}
+
+size_t utf16ToUtf8(const char16_t* s, size_t n, char* out)
+{
+    return kernels().toUtf8(s, n, out);
+}
+
+} // namespace detail
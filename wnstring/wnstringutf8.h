@@ -0,0 +1,30 @@
+#ifndef WNSTRINGUTF8_H
+#define WNSTRINGUTF8_H
+
+#include "wnstringsearch.h" // kNotFound
+
+#include <cstddef>
+
+// UTF-8 校验、ASCII 大小写转换与 UTF-8/UTF-16 互转的内核。运行时按 CPU 选择实现：
+//   AVX2:  校验用 Keiser-Lemire 查表法，每 32 字节 3 次 pshufb 查出相邻字节的非法组合，全程无分支；
+//          其余操作整块为 ASCII 时一次处理 32 字节
+//   SSE2:  整块 ASCII 时一次跳过/处理 16 字节，遇到非 ASCII 的块逐字符处理到块后第一个字符边界
+//   标量:  逐字符解码
+// 合法的 UTF-8 不含截断的序列、超长编码、代理区(U+D800~U+DFFF)和超过 U+10FFFF 的码点。
+namespace detail {
+
+bool validateUtf8(const char* s, size_t n);
+
+// 第一个落在 [first, first + 25] 的字节，first 为 'A' 或 'a'；没有返回 kNotFound
+size_t findAsciiLetter(const char* s, size_t n, char first);
+// 把 [first, first + 25] 内的字节异或 0x20(大小写互换)，其余字节不变
+void flipAsciiCase(char* s, size_t n, char first);
+
+// out 至少要有 n 个单元。返回写入的单元数，输入不合法返回 kNotFound
+size_t utf8ToUtf16(const char* s, size_t n, char16_t* out);
+// out 至少要有 3 * n 字节。返回写入的字节数，有不成对的代理返回 kNotFound
+size_t utf16ToUtf8(const char16_t* s, size_t n, char* out);
+
+} // namespace detail
+
+#endif // WNSTRINGUTF8_H
@@ -0,0 +1,271 @@
+#ifndef WNSTRINGVIEW_H
+#define WNSTRINGVIEW_H
+
+#include "wnstring.h"
+#include "wnstringhash.h"
+#include "wnstringsearch.h"
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
+// Wnstring 的只读片段。
+// 来自 large string (COW) 的视图持有 RefCounted 的一个引用：源字符串析构或被修改
+// (修改共享块会先 unshare)都不影响视图，切片不复制任何字节。
+// 直接从 small/medium string 或裸指针构造的视图只借用数据，与 std::string_view 一样不能比源活得久；
+// Wnstring::substr 则总是返回持有引用的视图。
+template <typename RefPolicy>
+class BasicWnstringView {
+public:
+    typedef BasicRefCounted<RefPolicy> RefCounted;
+    static constexpr size_t npos = BasicWnstring<RefPolicy>::npos;
+
+    BasicWnstringView() noexcept: BasicWnstringView("", 0) {}
+    BasicWnstringView(const char* data, size_t size) noexcept
+        : data_(data), size_(size), owner_(nullptr), ownerSize_(0), ownerCapacity_(0), ownerArena_(false)
+    {
+    }
+    BasicWnstringView(const char* s) noexcept: BasicWnstringView(s, strlen(s)) {}
+    BasicWnstringView(const BasicWnstring<RefPolicy>& s) noexcept;
+    BasicWnstringView(const BasicWnstringView& rhs) noexcept
+        : data_(rhs.data_), size_(rhs.size_), owner_(rhs.owner_), ownerSize_(rhs.ownerSize_)
+        , ownerCapacity_(rhs.ownerCapacity_), ownerArena_(rhs.ownerArena_)
+    {
+        if (owner_) {
+            RefCounted::incrementRefs(owner_);
+        }
+    }
+    BasicWnstringView(BasicWnstringView&& goner) noexcept
+        : data_(goner.data_), size_(goner.size_), owner_(goner.owner_), ownerSize_(goner.ownerSize_)
+        , ownerCapacity_(goner.ownerCapacity_), ownerArena_(goner.ownerArena_)
+    {
+        goner.owner_ = nullptr;
+    }
+    ~BasicWnstringView()
+    {
+        if (owner_) {
+            RefCounted::decrementRefs(owner_, ownerCapacity_, ownerArena_);
+        }
+    }
+    BasicWnstringView& operator=(BasicWnstringView rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+    void swap(BasicWnstringView& rhs) noexcept
+    {
+        std::swap(data_, rhs.data_);
+        std::swap(size_, rhs.size_);
+        std::swap(owner_, rhs.owner_);
+        std::swap(ownerSize_, rhs.ownerSize_);
+        std::swap(ownerCapacity_, rhs.ownerCapacity_);
+        std::swap(ownerArena_, rhs.ownerArena_);
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const char& operator[](size_t pos) const { return data_[pos]; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    // 是否持有 RefCounted 引用(即不依赖源字符串的生命期)
+    bool shared() const { return owner_ != nullptr; }
+
+    // 与源共享同一块内存，不复制
+    BasicWnstringView substr(size_t pos = 0, size_t n = npos) const
+    {
+        assert(pos <= size_);
+        pos = std::min(pos, size_);
+        BasicWnstringView result(*this);
+        result.data_ += pos;
+        result.size_ = std::min(n, size_ - pos);
+        return result;
+    }
+    void remove_prefix(size_t n)
+    {
+        assert(n <= size_);
+        data_ += n;
+        size_ -= n;
+    }
+    void remove_suffix(size_t n)
+    {
+        assert(n <= size_);
+        size_ -= n;
+    }
+
+    size_t find(const BasicWnstringView& s, size_t pos = 0) const
+    {
+        if (pos > size_) {
+            return npos;
+        }
+        size_t r = detail::searchForward(data_ + pos, size_ - pos, s.data_, s.size_);
+        return r == detail::kNotFound ? npos : r + pos;
+    }
+    size_t find(char c, size_t pos = 0) const { return find(BasicWnstringView(&c, 1), pos); }
+    size_t find_first_of(const BasicWnstringView& set, size_t pos = 0) const
+    {
+        if (pos >= size_) {
+            return npos;
+        }
+        size_t r = detail::searchFirstOf(data_ + pos, size_ - pos, set.data_, set.size_);
+        return r == detail::kNotFound ? npos : r + pos;
+    }
+
+    bool operator==(const BasicWnstringView& rhs) const
+    {
+        return size_ == rhs.size_ && (data_ == rhs.data_ || memcmp(data_, rhs.data_, size_) == 0);
+    }
+    bool operator!=(const BasicWnstringView& rhs) const { return !(*this == rhs); }
+    int compare(const BasicWnstringView& rhs) const
+    {
+        int r = memcmp(data_, rhs.data_, std::min(size_, rhs.size_));
+        return r != 0 ? r : (size_ < rhs.size_ ? -1 : (size_ > rhs.size_ ? 1 : 0));
+    }
+
+    explicit operator std::string_view() const { return std::string_view(data_, size_); }
+    // 与内容相同的 Wnstring::hash() 一致，可以混用做查找键
+    size_t hash() const { return detail::hashBytes(data_, size_); }
+
+    // 转成独立的 Wnstring。视图恰好覆盖整个共享块时直接共享，否则复制
+    BasicWnstring<RefPolicy> str() const;
+
+private:
+    const char* data_;
+    size_t size_;
+    char* owner_; // RefCounted::data_，借用时为 nullptr
+    size_t ownerSize_; // owner_ 所属 Wnstring 的长度
+    size_t ownerCapacity_; // 最后一个引用释放块时需要
+    bool ownerArena_;
+};
+
+typedef BasicWnstringView<AtomicRefs> WnstringView;
+typedef BasicWnstringView<LocalRefs> LocalWnstringView;
+
+namespace std {
+template <typename RefPolicy>
+struct hash<BasicWnstringView<RefPolicy>> {
+    size_t operator()(const BasicWnstringView<RefPolicy>& s) const noexcept { return s.hash(); }
+};
+} // namespace std
+
+// 按分隔符或字符集切分，迭代得到的每一段都是 WnstringView，不复制数据。
+//   for (WnstringView field : split(line, ",")) ...     // 保留空字段，"a,,b" -> "a" "" "b"
+//   for (WnstringView tok : tokenize(line, " \t")) ...  // 任一字符都是分隔符，跳过空段
+template <typename RefPolicy>
+class BasicWnstringSplitter {
+public:
+    typedef BasicWnstringView<RefPolicy> View;
+
+    enum Mode {
+        kSeparator,
+        kAnyOf,
+    };
+
+    class iterator {
+    public:
+        iterator(const BasicWnstringSplitter* owner, bool done): owner_(owner), pos_(0), end_(0), done_(done)
+        {
+            if (!done_) {
+                findField(0);
+            }
+        }
+        View operator*() const { return owner_->src_.substr(pos_, end_ - pos_); }
+        iterator& operator++()
+        {
+            if (owner_->mode_ == kSeparator && end_ < owner_->src_.size()) {
+                findField(end_ + owner_->delim_.size());
+            } else if (owner_->mode_ == kAnyOf) {
+                findField(end_);
+            } else {
+                done_ = true;
+            }
+            return *this;
+        }
+        bool operator==(const iterator& rhs) const
+        {
+            return done_ == rhs.done_ && (done_ || pos_ == rhs.pos_);
+        }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        void findField(size_t from)
+        {
+            const View& src = owner_->src_;
+            const View& delim = owner_->delim_;
+            if (owner_->mode_ == kSeparator) {
+                pos_ = from;
+                end_ = delim.empty() ? src.size() : std::min(src.find(delim, from), src.size());
+                return;
+            }
+            while (from < src.size() && memchr(delim.data(), src[from], delim.size())) {
+                ++from;
+            }
+            if (from >= src.size()) {
+                done_ = true;
+                return;
+            }
+            pos_ = from;
+            end_ = std::min(src.find_first_of(delim, from), src.size());
+        }
+
+        const BasicWnstringSplitter* owner_;
+        size_t pos_;
+        size_t end_;
+        bool done_;
+    };
+
+    BasicWnstringSplitter(View src, View delim, Mode mode)
+        : src_(std::move(src)), delim_(std::move(delim)), mode_(mode)
+    {
+    }
+
+    iterator begin() const { return iterator(this, false); }
+    iterator end() const { return iterator(this, true); }
+
+private:
+    View src_;
+    View delim_;
+    Mode mode_;
+};
+
+typedef BasicWnstringSplitter<AtomicRefs> WnstringSplitter;
+typedef BasicWnstringSplitter<LocalRefs> LocalWnstringSplitter;
+
+// 源是 BasicWnstring/BasicWnstringView 时按源推导线程策略；分隔符处于非推导语境，可以直接传字面量
+template <typename RefPolicy>
+BasicWnstringSplitter<RefPolicy> split(const BasicWnstring<RefPolicy>& src,
+    typename BasicWnstringSplitter<RefPolicy>::View separator)
+{
+    return BasicWnstringSplitter<RefPolicy>(src, std::move(separator), BasicWnstringSplitter<RefPolicy>::kSeparator);
+}
+template <typename RefPolicy>
+BasicWnstringSplitter<RefPolicy> split(BasicWnstringView<RefPolicy> src,
+    typename BasicWnstringSplitter<RefPolicy>::View separator)
+{
+    return BasicWnstringSplitter<RefPolicy>(std::move(src), std::move(separator),
+        BasicWnstringSplitter<RefPolicy>::kSeparator);
+}
+template <typename RefPolicy>
+BasicWnstringSplitter<RefPolicy> tokenize(const BasicWnstring<RefPolicy>& src,
+    typename BasicWnstringSplitter<RefPolicy>::View delimiters)
+{
+    return BasicWnstringSplitter<RefPolicy>(src, std::move(delimiters), BasicWnstringSplitter<RefPolicy>::kAnyOf);
+}
+template <typename RefPolicy>
+BasicWnstringSplitter<RefPolicy> tokenize(BasicWnstringView<RefPolicy> src,
+    typename BasicWnstringSplitter<RefPolicy>::View delimiters)
+{
+    return BasicWnstringSplitter<RefPolicy>(std::move(src), std::move(delimiters),
+        BasicWnstringSplitter<RefPolicy>::kAnyOf);
+}
+// 裸字符串按默认策略处理
+inline WnstringSplitter split(const char* src, WnstringView separator)
+{
+    return split(WnstringView(src), std::move(separator));
+}
+inline WnstringSplitter tokenize(const char* src, WnstringView delimiters)
+{
+    return tokenize(WnstringView(src), std::move(delimiters));
+}
+
+#endif // WNSTRINGVIEW_H
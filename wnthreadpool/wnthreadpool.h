@@ -4,10 +4,15 @@
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
+// 多个模块各自定义了 noncopyable，同时包含时只保留一份
+#ifndef WN_NONCOPYABLE_DEFINED
+#define WN_NONCOPYABLE_DEFINED
 // 单例类
 class noncopyable {
 public:
@@ -18,6 +23,7 @@ protected:
     noncopyable() = default;
     ~noncopyable() = default;
 };
+#endif
 
 class ThreadPool : noncopyable {
 public: